@@ -1,54 +1,242 @@
+#ifndef DS1_TREE_SUCCESSOR_H
+#define DS1_TREE_SUCCESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Other assignments use the same names (Tree, Node, ...) for their trees,
+// so ours live in their own namespace.
+namespace successor {
+
+// Value stored in a node next to its key.
+template<typename V>
+class NodeValue {
+  public:
+    V value;
+
+    template<typename... Args>
+    explicit NodeValue(Args&&... args) : value(std::forward<Args>(args)...) {}
+};
+
+// Trees without values are sets; the empty base takes no space in the node.
+template<>
+class NodeValue<void> {};
+
 // A node of the tree
-class Node {
+template<typename K, typename V=void>
+class BasicNode : public NodeValue<V> {
   public:
-    int key;
-    Node* left;
-    Node* right;
-    Node* parent;
-
-    // Constructor
-    Node(int key, Node* parent=nullptr) {
-        this->key = key;
+    K key;
+    BasicNode* left;
+    BasicNode* right;
+    BasicNode* parent;
+
+    // Constructor; the extra arguments are used to construct the value.
+    template<typename... Args>
+    BasicNode(const K& key, BasicNode* parent=nullptr, Args&&... value)
+        : NodeValue<V>(std::forward<Args>(value)...), key(key) {
         this->parent = parent;
         this->left = nullptr;
         this->right = nullptr;
     }
 };
 
-// Binary tree
-class Tree {
+// Slab allocator for nodes.
+//
+// Nodes are carved out of large slabs by bumping a pointer, so consecutively
+// created nodes lie next to each other in memory. Nodes cannot be freed one
+// by one; all of them are released at once when the pool is destroyed.
+//
+// This is the default pool of the trees below. Any class template with the
+// same create(), reserve() and clear() members can be plugged in instead.
+template<typename N>
+class NodePool {
+    struct Slab {
+        N* nodes;
+        std::size_t used;
+        std::size_t capacity;
+    };
+
+    std::vector<Slab> slabs;
+    std::size_t next_capacity = MIN_SLAB;
+
+    void add_slab(std::size_t capacity) {
+        N* nodes = static_cast<N*>(::operator new(capacity * sizeof(N)));
+        slabs.push_back({nodes, 0, capacity});
+    }
+
+    std::size_t available() const {
+        return slabs.empty() ? 0 : slabs.back().capacity - slabs.back().used;
+    }
+
+  public:
+    // Slabs grow geometrically from MIN_SLAB up to MAX_SLAB nodes.
+    static constexpr std::size_t MIN_SLAB = 64;
+    static constexpr std::size_t MAX_SLAB = 1 << 16;
+
+    NodePool() {}
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    // Make sure the next `count` nodes are allocated from one contiguous block.
+    void reserve(std::size_t count) {
+        if (available() < count)
+            add_slab(count);
+    }
+
+    // Construct a new node, passing the arguments to its constructor.
+    template<typename... Args>
+    N* create(Args&&... args) {
+        if (!available()) {
+            add_slab(next_capacity);
+            if (next_capacity < MAX_SLAB)
+                next_capacity *= 2;
+        }
+
+        Slab& slab = slabs.back();
+        N* node = new (slab.nodes + slab.used) N(std::forward<Args>(args)...);
+        slab.used++;
+        return node;
+    }
+
+    // Destroy all nodes and return the memory.
+    void clear() {
+        for (Slab& slab : slabs) {
+            for (std::size_t i = 0; i < slab.used; i++)
+                slab.nodes[i].~N();
+            ::operator delete(slab.nodes);
+        }
+        slabs.clear();
+        next_capacity = MIN_SLAB;
+    }
+
+    ~NodePool() {
+        clear();
+    }
+};
+
+// Binary tree mapping keys of type K to values of type V (a set if V is void).
+// Keys are ordered by Compare, nodes are allocated from a Pool<Node>.
+template<typename K=int, typename V=void, typename Compare=std::less<K>,
+         template<typename> class Pool=NodePool>
+class BasicTree {
+  public:
+    typedef BasicNode<K, V> Node;
+
+  private:
+    // All nodes of the tree are allocated from this pool.
+    Pool<Node> pool;
+
+    Compare less;
+
+    // Link nodes of a sorted array into a perfectly balanced subtree
+    // and return its root.
+    static Node* link_balanced(Node* begin, Node* end, Node* parent) {
+        if (begin == end)
+            return nullptr;
+
+        Node* middle = begin + (end - begin) / 2;
+        middle->parent = parent;
+        middle->left = link_balanced(begin, middle, middle);
+        middle->right = link_balanced(middle + 1, end, middle);
+        return middle;
+    }
+
   public:
     // Pointer to root of the tree; nullptr if the tree is empty.
     Node* root = nullptr;
 
-    // Insert a key into the tree.
+    // Prepare for inserting `count` more keys, so that their nodes
+    // end up in one contiguous block of memory.
+    void reserve(std::size_t count) {
+        pool.reserve(count);
+    }
+
+    explicit BasicTree(const Compare& less=Compare()) : less(less) {}
+
+    // The comparator ordering the keys.
+    const Compare& key_comp() const {
+        return less;
+    }
+
+    // Insert a key into the tree and return its node.
+    // The extra arguments are used to construct the value.
     // If the key is already present, nothing happens.
-    void insert(int key) {
-        if (!root) {
-            root = new Node(key);
-            return;
-        }
+    template<typename... Args>
+    Node* insert(const K& key, Args&&... value) {
+        if (!root)
+            return root = pool.create(key, nullptr, std::forward<Args>(value)...);
 
         Node* node = root;
-        while (node->key != key) {
-            if (key < node->key) {
+        while (true) {
+            if (less(key, node->key)) {
                 if (!node->left)
-                    node->left = new Node(key, node);
+                    return node->left = pool.create(key, node, std::forward<Args>(value)...);
                 node = node->left;
-            } else {
+            } else if (less(node->key, key)) {
                 if (!node->right)
-                    node->right = new Node(key, node);
+                    return node->right = pool.create(key, node, std::forward<Args>(value)...);
                 node = node->right;
+            } else {
+                return node;
             }
         }
     }
 
+    // Return the node with the given key, or nullptr if there is none.
+    Node* find(const K& key) const {
+        Node* node = root;
+        while (node) {
+            if (less(key, node->key))
+                node = node->left;
+            else if (less(node->key, key))
+                node = node->right;
+            else
+                return node;
+        }
+        return nullptr;
+    }
+
+    // Replace the contents of the tree by keys from a sorted range.
+    //
+    // The resulting tree is perfectly balanced and its nodes are stored
+    // in one block in increasing order of keys, so walking successors
+    // touches memory sequentially. Keys which are not greater than their
+    // predecessor in the range are skipped. Values are value-initialized.
+    template<typename ForwardIterator>
+    void build_from_sorted(ForwardIterator begin, ForwardIterator end) {
+        pool.clear();
+        root = nullptr;
+
+        pool.reserve(std::distance(begin, end));
+
+        Node* first = nullptr, *last = nullptr;
+        for (; begin != end; ++begin) {
+            if (last && !less(last->key, *begin))
+                continue;
+            last = pool.create(*begin);
+            if (!first)
+                first = last;
+        }
+
+        if (first)
+            root = link_balanced(first, last + 1, nullptr);
+    }
+
     // Return successor of the given node.
     //
     // The successor of a node is the node with the next higher key.
     // Return nullptr if there is no such node.
     // If the argument is nullptr, return the node with the smallest key.
-    Node* successor(Node* node) {
+    Node* successor(Node* node) const {
+        if (!node && !root)
+            return nullptr;
+
         Node* tmp = (node) ? node->right : root;
 
         if (tmp) {
@@ -69,22 +257,302 @@ class Tree {
         }
     }
 
-    // Destructor to free all allocated memory.
-    ~Tree() {
-        Node* node = root;
+    // Forward iterator visiting the nodes in increasing order of keys.
+    class iterator {
+        const BasicTree* tree;
+        Node* node;
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Node* pointer;
+        typedef Node& reference;
+
+        iterator(const BasicTree* tree=nullptr, Node* node=nullptr) : tree(tree), node(node) {}
+
+        reference operator*() const { return *node; }
+        pointer operator->() const { return node; }
+
+        iterator& operator++() {
+            node = tree->successor(node);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const iterator& other) const { return node == other.node; }
+        bool operator!=(const iterator& other) const { return node != other.node; }
+    };
+
+    iterator begin() const {
+        return iterator(this, successor(nullptr));
+    }
+
+    iterator end() const {
+        return iterator(this, nullptr);
+    }
+
+    // Return an iterator to the first node whose key is not less than the given one.
+    iterator lower_bound(const K& key) const {
+        Node* node = root, *bound = nullptr;
         while (node) {
-            Node* next;
-            if (node->left) {
-                next = node->left;
-                node->left = nullptr;
-            } else if (node->right) {
-                next = node->right;
-                node->right = nullptr;
+            if (less(node->key, key)) {
+                node = node->right;
+            } else {
+                bound = node;
+                node = node->left;
+            }
+        }
+        return iterator(this, bound);
+    }
+
+    // Call `callback` on all nodes with keys between `lo` and `hi` inclusive,
+    // in increasing order of keys. The tree is descended only once to find
+    // the first node, then successors are streamed.
+    template<typename Callback>
+    void scan(const K& lo, const K& hi, Callback callback) const {
+        for (iterator it = lower_bound(lo), last = end(); it != last && !less(hi, it->key); ++it)
+            callback(*it);
+    }
+
+    // Append all keys between `lo` and `hi` inclusive to `out`, in increasing order.
+    void collect(const K& lo, const K& hi, std::vector<K>& out) const {
+        scan(lo, hi, [&out](const Node& node) { out.push_back(node.key); });
+    }
+};
+
+typedef BasicTree<> Tree;
+typedef Tree::Node Node;
+
+// Allocator returning memory which starts at a cache line boundary.
+//
+// The block is over-allocated by one cache line; the pointer returned by
+// operator new is kept just before the aligned start.
+template<typename T>
+class CacheAlignedAllocator {
+  public:
+    typedef T value_type;
+
+    static constexpr std::size_t LINE = 64;
+
+    CacheAlignedAllocator() {}
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        char* raw = static_cast<char*>(::operator new(n * sizeof(T) + LINE));
+        char* aligned = raw + LINE - reinterpret_cast<std::uintptr_t>(raw) % LINE;
+        reinterpret_cast<char**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(reinterpret_cast<char**>(p)[-1]);
+    }
+
+    template<typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+// Immutable pointer-free snapshot of a Tree.
+//
+// Keys are stored in Eytzinger order: the root of an implicit complete binary
+// search tree is at index 1 and children of index k are at 2k and 2k+1.
+// An int key takes 4 bytes instead of a 32-byte Node and a descent needs no
+// pointers, so it can be made branchless and the descendants a few levels
+// below can be prefetched in advance: the array starts at a cache line
+// boundary, so the 16 int descendants 16k..16k+15 fill exactly one line.
+template<typename K=int, typename Compare=std::less<K>>
+class BasicEytzingerTree {
+    // keys[1..n] hold the keys, keys[0] is unused.
+    std::vector<K, CacheAlignedAllocator<K>> keys;
+
+    Compare less;
+
+    // Descendants of k which are this many levels below share a cache line.
+    static constexpr std::size_t PREFETCH_STRIDE = sizeof(K) < 64 ? 64 / sizeof(K) : 1;
+
+    template<typename Iterator>
+    void fill(std::size_t k, Iterator& it) {
+        if (k < keys.size()) {
+            fill(2 * k, it);
+            keys[k] = it->key;
+            ++it;
+            fill(2 * k + 1, it);
+        }
+    }
+
+    // Start loading keys[k] into the cache; deep indices past the end are skipped.
+    void prefetch(std::size_t k) const {
+#ifdef __GNUC__
+        if (k < keys.size())
+            __builtin_prefetch(&keys[k]);
+#else
+        (void) k;
+#endif
+    }
+
+    // Undo the descent: strip the trailing right turns (and the final left turn)
+    // to reach the last node where we went left. Return nullptr if there is none.
+    const K* last_left_turn(std::size_t k) const {
+#ifdef __GNUC__
+        k >>= __builtin_ffsll(~k);
+#else
+        while (k & 1)
+            k >>= 1;
+        k >>= 1;
+#endif
+        return k ? &keys[k] : nullptr;
+    }
+
+  public:
+    template<typename V, template<typename> class Pool>
+    explicit BasicEytzingerTree(const BasicTree<K, V, Compare, Pool>& tree)
+        : keys(std::distance(tree.begin(), tree.end()) + 1), less(tree.key_comp()) {
+        typename BasicTree<K, V, Compare, Pool>::iterator it = tree.begin();
+        fill(1, it);
+    }
+
+    // Number of keys in the snapshot.
+    std::size_t size() const {
+        return keys.size() - 1;
+    }
+
+    // Return a pointer to the smallest key greater than the given one,
+    // or nullptr if there is no such key.
+    const K* successor(const K& key) const {
+        std::size_t k = 1, n = size();
+        while (k <= n) {
+            prefetch(PREFETCH_STRIDE * k);
+            k = 2 * k + !less(key, keys[k]);
+        }
+        return last_left_turn(k);
+    }
+
+    // Return a pointer to the smallest key not less than the given one,
+    // or nullptr if there is no such key.
+    const K* lower_bound(const K& key) const {
+        std::size_t k = 1, n = size();
+        while (k <= n) {
+            prefetch(PREFETCH_STRIDE * k);
+            k = 2 * k + less(keys[k], key);
+        }
+        return last_left_turn(k);
+    }
+};
+
+typedef BasicEytzingerTree<> EytzingerTree;
+
+// A node of the threaded tree
+//
+// There is no parent pointer. If the node has no right child, `right`
+// points to its in-order successor instead (or is nullptr for the maximum)
+// and `right_thread` is set.
+template<typename K, typename V=void>
+class BasicThreadedNode : public NodeValue<V> {
+  public:
+    K key;
+    bool right_thread;
+    BasicThreadedNode* left;
+    BasicThreadedNode* right;
+
+    // Constructor; the extra arguments are used to construct the value.
+    template<typename... Args>
+    BasicThreadedNode(const K& key, BasicThreadedNode* successor=nullptr, Args&&... value)
+        : NodeValue<V>(std::forward<Args>(value)...), key(key) {
+        this->right_thread = true;
+        this->left = nullptr;
+        this->right = successor;
+    }
+};
+
+// Right-threaded binary tree
+//
+// It offers the same insert/successor interface as BasicTree, but successor()
+// never climbs upwards: it either follows a thread or descends to the
+// leftmost node of the right subtree, so a full scan takes O(1) amortized
+// time per node.
+template<typename K=int, typename V=void, typename Compare=std::less<K>,
+         template<typename> class Pool=NodePool>
+class BasicThreadedTree {
+  public:
+    typedef BasicThreadedNode<K, V> Node;
+
+  private:
+    // All nodes of the tree are allocated from this pool.
+    Pool<Node> pool;
+
+    Compare less;
+
+    static Node* leftmost(Node* node) {
+        while (node->left)
+            node = node->left;
+        return node;
+    }
+
+  public:
+    // Pointer to root of the tree; nullptr if the tree is empty.
+    Node* root = nullptr;
+
+    explicit BasicThreadedTree(const Compare& less=Compare()) : less(less) {}
+
+    // Prepare for inserting `count` more keys, so that their nodes
+    // end up in one contiguous block of memory.
+    void reserve(std::size_t count) {
+        pool.reserve(count);
+    }
+
+    // Insert a key into the tree and return its node.
+    // The extra arguments are used to construct the value.
+    // If the key is already present, nothing happens.
+    template<typename... Args>
+    Node* insert(const K& key, Args&&... value) {
+        if (!root)
+            return root = pool.create(key, nullptr, std::forward<Args>(value)...);
+
+        Node* node = root;
+        while (true) {
+            if (less(key, node->key)) {
+                if (!node->left)
+                    return node->left = pool.create(key, node, std::forward<Args>(value)...);
+                node = node->left;
+            } else if (less(node->key, key)) {
+                if (node->right_thread) {
+                    node->right = pool.create(key, node->right, std::forward<Args>(value)...);
+                    node->right_thread = false;
+                    return node->right;
+                }
+                node = node->right;
             } else {
-                next = node->parent;
-                delete node;
+                return node;
             }
-            node = next;
         }
     }
+
+    // Return successor of the given node.
+    //
+    // The successor of a node is the node with the next higher key.
+    // Return nullptr if there is no such node.
+    // If the argument is nullptr, return the node with the smallest key.
+    Node* successor(Node* node) const {
+        if (!node)
+            return root ? leftmost(root) : nullptr;
+        if (node->right_thread)
+            return node->right;
+        return leftmost(node->right);
+    }
 };
+
+typedef BasicThreadedTree<> ThreadedTree;
+typedef ThreadedTree::Node ThreadedNode;
+
+}  // namespace successor
+
+#endif
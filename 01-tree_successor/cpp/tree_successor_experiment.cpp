@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tree_successor.h"
+#include "random.h"
+
+using namespace std;
+using namespace successor;
+
+RandomGen *rng;         // Random generator object
+
+// Run `body` repeatedly until it takes at least `min_time` seconds
+// and return the average duration of one run in seconds.
+double measure(const function<void()>& body, double min_time = .1)
+{
+    unsigned tries = 1;
+    std::chrono::duration<double> difference;
+
+    do {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (unsigned t=0; t < tries; t++)
+            body();
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        if ((difference = end - start).count() >= min_time) break;
+        tries *= 2;
+    } while (true);
+
+    return difference.count() / tries;
+}
+
+// An auxiliary function for generating a random permutation.
+vector<int> random_permutation(int n)
+{
+    vector<int> perm;
+    for (int i=0; i<n; i++)
+        perm.push_back(i);
+    for (int i=0; i<n-1; i++)
+        swap(perm[i], perm[i + rng->next_range(n-i)]);
+    return perm;
+}
+
+// Insert the keys in the given order, then walk all successors.
+// Print the set size, nanoseconds per insert and nanoseconds per successor.
+template<typename T>
+void test_order(const vector<int>& keys)
+{
+    double insert_time = measure([&]{
+        T tree;
+        for (int x : keys)
+            tree.insert(x);
+    });
+
+    T tree;
+    for (int x : keys)
+        tree.insert(x);
+
+    volatile long checksum = 0;
+    double scan_time = measure([&]{
+        long sum = 0;
+        for (auto node = tree.successor(nullptr); node; node = tree.successor(node))
+            sum += node->key;
+        checksum = checksum + sum;
+    });
+
+    printf("%zu\t%.3f\t%.3f\n", keys.size(),
+           insert_time / keys.size() * 1e9, scan_time / keys.size() * 1e9);
+}
+
+// Random insertion order, the trees have logarithmic expected depth.
+template<typename T>
+void test_random()
+{
+    for (int e=40; e<=88; e++)
+        test_order<T>(random_permutation((int) pow(2, e/4.)));
+}
+
+// Sorted insertion order, the trees degenerate to paths.
+template<typename T>
+void test_sorted()
+{
+    for (int e=40; e<=56; e++) {
+        vector<int> keys((int) pow(2, e/4.));
+        for (int i=0; i<keys.size(); i++)
+            keys[i] = i;
+        test_order<T>(keys);
+    }
+}
+
+vector<pair<string, function<void()>>> tests = {
+    { "random-parent",   test_random<Tree> },
+    { "random-threaded", test_random<ThreadedTree> },
+    { "sorted-parent",   test_sorted<Tree> },
+    { "sorted-threaded", test_sorted<ThreadedTree> },
+};
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s (random|sorted) <student-id> (parent|threaded)\n", argv[0]);
+        return 1;
+    }
+
+    string which_test = string(argv[1]) + "-" + argv[3];
+
+    try {
+        rng = new RandomGen(stoi(argv[2]));
+    } catch (...) {
+        fprintf(stderr, "Invalid student ID\n");
+        return 1;
+    }
+
+    for (const auto& test : tests) {
+        if (test.first == which_test) {
+            test.second();
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown test %s\n", which_test.c_str());
+    return 1;
+}
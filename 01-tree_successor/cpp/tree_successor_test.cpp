@@ -8,20 +8,22 @@
 #include "tree_successor.h"
 
 using namespace std;
+using namespace successor;
 
 // If the condition is not true, report an error and halt.
 #define EXPECT(condition, message) do { if (!(condition)) expect_failed(message); } while (0)
 void expect_failed(const string& message);
 
+template<typename T>
 void test(const vector<int>& sequence) {
-    Tree tree;
+    T tree;
     for (const auto& element : sequence)
         tree.insert(element);
 
     vector<int> sorted_sequence(sequence);
     sort(sorted_sequence.begin(), sorted_sequence.end());
 
-    Node* node = tree.successor(nullptr);
+    auto node = tree.successor(nullptr);
     for (const auto& element : sorted_sequence) {
         EXPECT(node, "Expected successor " + to_string(element) + ", got nullptr");
         EXPECT(node->key == element,
@@ -31,18 +33,237 @@ void test(const vector<int>& sequence) {
     EXPECT(!node, "Expected no successor, got " + to_string(node->key));
 }
 
+// Nodes of keys inserted after reserve() must occupy one contiguous block.
+void test_reserve(int n) {
+    Tree tree;
+    tree.reserve(n);
+    for (int i = 0; i < n; i++)
+        tree.insert((i * int64_t(997)) % n);
+
+    Node* lowest = nullptr, *highest = nullptr;
+    for (Node* node = tree.successor(nullptr); node; node = tree.successor(node)) {
+        if (!lowest || node < lowest) lowest = node;
+        if (!highest || node > highest) highest = node;
+    }
+    EXPECT(highest - lowest == n - 1, "Reserved nodes are not contiguous");
+}
+
+// Depth of the deepest node in the subtree.
+int depth(Node* node) {
+    return node ? 1 + max(depth(node->left), depth(node->right)) : 0;
+}
+
+void test_sorted_build(int n) {
+    vector<int> sorted_sequence;
+    for (int i = 0; i < n; i++) {
+        sorted_sequence.push_back(3 * i);
+        if (i % 7 == 0)
+            sorted_sequence.push_back(3 * i);
+    }
+
+    Tree tree;
+    tree.insert(-1);
+    tree.build_from_sorted(sorted_sequence.begin(), sorted_sequence.end());
+
+    Node* node = tree.successor(nullptr);
+    for (int i = 0; i < n; i++) {
+        EXPECT(node, "Expected successor " + to_string(3 * i) + ", got nullptr");
+        EXPECT(node->key == 3 * i,
+               "Expected successor " + to_string(3 * i) + ", got " + to_string(node->key));
+        Node* next = tree.successor(node);
+        EXPECT(!next || next == node + 1, "Nodes are not stored in key order");
+        node = next;
+    }
+    EXPECT(!node, "Expected no successor, got " + to_string(node->key));
+
+    int max_depth = 0;
+    while ((1 << max_depth) <= n) max_depth++;
+    EXPECT(depth(tree.root) == max_depth, "Tree built from sorted keys is not balanced");
+}
+
+void test_range(int n) {
+    // Insert multiples of 3 from [0, 3n) in pseudo-random order.
+    Tree tree;
+    EXPECT(tree.begin() == tree.end(), "Empty tree has non-empty iteration range");
+    for (int i = 0; i < n; i++)
+        tree.insert(3 * ((i * int64_t(997)) % n));
+
+    int expected = 0;
+    for (const Node& node : tree) {
+        EXPECT(node.key == expected,
+               "Expected key " + to_string(expected) + ", got " + to_string(node.key));
+        expected += 3;
+    }
+    EXPECT(expected == 3 * n, "Iteration ended too early");
+
+    for (int lo = -5; lo < 3 * n + 5; lo += 1 + lo / 10) {
+        Tree::iterator it = tree.lower_bound(lo);
+        int first = max(0, (lo + 2) / 3 * 3);
+        if (first >= 3 * n)
+            EXPECT(it == tree.end(), "Expected lower bound of " + to_string(lo) + " to be end");
+        else
+            EXPECT(it != tree.end() && it->key == first,
+                   "Wrong lower bound of " + to_string(lo));
+
+        int hi = lo + 100;
+        vector<int> collected, expected_keys;
+        tree.collect(lo, hi, collected);
+        for (int key = first; key <= hi && key < 3 * n; key += 3)
+            expected_keys.push_back(key);
+        EXPECT(collected == expected_keys,
+               "Wrong keys collected from range " + to_string(lo) + ".." + to_string(hi));
+    }
+}
+
+void test_eytzinger(int n) {
+    // Insert even numbers from [0, 2n) in pseudo-random order.
+    Tree tree;
+    for (int i = 0; i < n; i++)
+        tree.insert(2 * ((i * int64_t(997)) % n));
+
+    EytzingerTree frozen(tree);
+    EXPECT(frozen.size() == n, "Snapshot has wrong size");
+
+    for (int key = -3; key < 2 * n + 3; key++) {
+        const int* next = frozen.successor(key);
+        int expected = max(0, key + 2 - (key & 1));
+        if (expected >= 2 * n)
+            EXPECT(!next, "Expected no successor of " + to_string(key) + ", got " + to_string(*next));
+        else
+            EXPECT(next && *next == expected, "Wrong successor of " + to_string(key));
+
+        const int* bound = frozen.lower_bound(key);
+        expected = max(0, key + (key & 1));
+        if (expected >= 2 * n)
+            EXPECT(!bound, "Expected no lower bound of " + to_string(key) + ", got " + to_string(*bound));
+        else
+            EXPECT(bound && *bound == expected, "Wrong lower bound of " + to_string(key));
+    }
+}
+
+// Map 64-bit keys to strings, ordered from the largest key.
+void test_key_value(int n) {
+    BasicTree<uint64_t, string, greater<uint64_t>> tree;
+    for (int i = 0; i < n; i++) {
+        uint64_t key = ((i * uint64_t(997)) % n) << 32;
+        auto node = tree.insert(key, to_string(key));
+        EXPECT(node->key == key && node->value == to_string(key), "Wrong node returned by insert");
+        EXPECT(tree.insert(key, "duplicate") == node, "Duplicate key was inserted");
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint64_t key = uint64_t(i) << 32;
+        auto node = tree.find(key);
+        EXPECT(node && node->value == to_string(key), "Value of key " + to_string(key) + " was lost");
+        EXPECT(!tree.find(key + 1), "Non-existing key was found");
+    }
+
+    uint64_t expected = uint64_t(n) << 32;
+    for (auto node = tree.successor(nullptr); node; node = tree.successor(node)) {
+        expected -= uint64_t(1) << 32;
+        EXPECT(node->key == expected, "Keys are not ordered by the comparator");
+    }
+    EXPECT(expected == 0, "Iteration ended too early");
+
+    BasicEytzingerTree<uint64_t, greater<uint64_t>> frozen(tree);
+    const uint64_t* next = frozen.successor(uint64_t(n / 2) << 32);
+    EXPECT(next && *next == uint64_t(n / 2 - 1) << 32, "Wrong successor in a frozen map");
+}
+
+// A comparator whose ordering is chosen at run time.
+struct DirectedLess {
+    bool reverse = false;
+
+    bool operator()(int x, int y) const { return reverse ? y < x : x < y; }
+};
+
+// A snapshot must order keys by the comparator of its tree.
+void test_eytzinger_comparator(int n) {
+    DirectedLess reverse;
+    reverse.reverse = true;
+    BasicTree<int, void, DirectedLess> tree(reverse);
+    for (int i = 0; i < n; i++)
+        tree.insert((i * int64_t(997)) % n);
+
+    BasicEytzingerTree<int, DirectedLess> frozen(tree);
+    for (int key = 1; key < n; key++) {
+        const int* next = frozen.successor(key);
+        EXPECT(next && *next == key - 1, "Snapshot ignores the comparator of its tree");
+    }
+    EXPECT(!frozen.successor(0), "Expected no successor of the last key");
+}
+
+// A pool which counts the nodes it creates.
+int pool_nodes;
+
+template<typename N>
+class CountingPool : public NodePool<N> {
+  public:
+    template<typename... Args>
+    N* create(Args&&... args) {
+        pool_nodes++;
+        return NodePool<N>::create(std::forward<Args>(args)...);
+    }
+};
+
+// Trees must allocate all their nodes from the pool they are given.
+void test_custom_pool(int n) {
+    pool_nodes = 0;
+    {
+        BasicTree<int, void, less<int>, CountingPool> tree;
+        for (int i = 0; i < n; i++)
+            tree.insert((i * int64_t(997)) % n);
+        tree.insert(0);
+        EXPECT(pool_nodes == n, "Tree did not allocate nodes from its pool");
+    }
+
+    pool_nodes = 0;
+    {
+        BasicThreadedTree<int, void, less<int>, CountingPool> tree;
+        for (int i = 0; i < n; i++)
+            tree.insert((i * int64_t(997)) % n);
+        EXPECT(pool_nodes == n, "Threaded tree did not allocate nodes from its pool");
+    }
+}
+
 vector<pair<string, function<void()>>> tests = {
+    {"empty", []
+        { test<Tree>({}); test<ThreadedTree>({}); }
+    },
     {"path", []
         { vector<int> numbers;
             for (int i = 0; i < 10000; i++) numbers.push_back(i);
-            test(numbers);
+            test<Tree>(numbers);
+            test<ThreadedTree>(numbers);
         }
     },
     {"random_tree", []
         { vector<int> numbers = {997};
             for (int i = 2; i < 199999; i++)
                 numbers.push_back((numbers.back() * int64_t(997)) % 199999);
-            test(numbers);
+            test<Tree>(numbers);
+            test<ThreadedTree>(numbers);
         }
     },
+    {"reserve", []
+        { test_reserve(199999); }
+    },
+    {"sorted_build", []
+        { test_sorted_build(1000000); }
+    },
+    {"range", []
+        { test_range(19999); }
+    },
+    {"eytzinger", []
+        { test_eytzinger(1); test_eytzinger(2); test_eytzinger(199999); }
+    },
+    {"eytzinger_comparator", []
+        { test_eytzinger_comparator(19999); }
+    },
+    {"key_value", []
+        { test_key_value(19999); }
+    },
+    {"custom_pool", []
+        { test_custom_pool(19999); }
+    },
 };
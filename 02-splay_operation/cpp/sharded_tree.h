@@ -0,0 +1,104 @@
+#ifndef DS1_SHARDED_TREE_H
+#define DS1_SHARDED_TREE_H
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "splay_operation.h"
+
+namespace splay {
+
+// Thread-safe splay tree partitioned by key ranges into independent shards
+//
+// With bounds b_0 < b_1 < ... < b_{s-1}, shard i holds the keys in [b_{i-1}, b_i)
+// (the first and the last shard are unbounded). Each shard has its own
+// reader-writer lock. Updates lock their shard exclusively. Lookups try to
+// do the same and splay, but if the shard is busy, they fall back to a shared
+// lock and a search without splaying, so that readers of a hot shard proceed
+// in parallel instead of queueing.
+//
+// Nodes cannot be handed out, since they may be freed as soon as the lock
+// is released. Instead, lookup() calls the given visitor on the node while
+// holding the lock.
+template<typename K=int, typename V=void, typename Compare=std::less<K>, typename Strategy=FullSplay>
+class ShardedTree {
+  public:
+    typedef BasicTree<K, V, Compare, NoStats, Strategy> Tree;
+    typedef typename Tree::Node Node;
+
+  private:
+    // Each shard gets its own cache line, so that the locks do not share them.
+    struct alignas(64) Shard {
+        std::shared_mutex lock;
+        Tree tree;
+    };
+
+    std::vector<K> bounds;
+    std::vector<Shard> shards;
+    Compare less;
+
+    Shard& shard(const K& key) {
+        return shards[std::upper_bound(bounds.begin(), bounds.end(), key, less) - bounds.begin()];
+    }
+
+  public:
+    explicit ShardedTree(std::vector<K> bounds=std::vector<K>(), const Compare& less=Compare())
+        : bounds(std::move(bounds)), shards(this->bounds.size() + 1), less(less) {
+        // Shards are not movable because of their locks, so their trees
+        // get the comparator afterwards.
+        for (Shard& s : shards)
+            s.tree = Tree(nullptr, less);
+    }
+
+    // Number of shards
+    std::size_t size() const {
+        return shards.size();
+    }
+
+    // Look up the given key, call `visit` on its node if it is present
+    // and return whether it was.
+    template<typename Visitor>
+    bool lookup(const K& key, Visitor visit) {
+        Shard& s = shard(key);
+        Node* node;
+        if (s.lock.try_lock()) {
+            std::lock_guard<std::shared_mutex> guard(s.lock, std::adopt_lock);
+            if ((node = s.tree.lookup(key)))
+                visit(*node);
+        } else {
+            std::shared_lock<std::shared_mutex> guard(s.lock);
+            if ((node = s.tree.find(key)))
+                visit(*node);
+        }
+        return node;
+    }
+
+    bool lookup(const K& key) {
+        return lookup(key, [](const Node&) {});
+    }
+
+    // Insert a key into the tree, the extra arguments are used to construct
+    // the value. If the key is already present, nothing happens.
+    template<typename... Args>
+    void insert(const K& key, Args&&... value) {
+        Shard& s = shard(key);
+        std::lock_guard<std::shared_mutex> guard(s.lock);
+        s.tree.insert(key, std::forward<Args>(value)...);
+    }
+
+    // Delete given key from the tree.
+    // It the key is not present, nothing happens.
+    void remove(const K& key) {
+        Shard& s = shard(key);
+        std::lock_guard<std::shared_mutex> guard(s.lock);
+        s.tree.remove(key);
+    }
+};
+
+}  // namespace splay
+
+#endif
@@ -1,14 +1,45 @@
+#ifndef DS1_SPLAY_OPERATION_H
+#define DS1_SPLAY_OPERATION_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Other assignments use the same names (Tree, Node, ...) for their trees,
+// so ours live in their own namespace.
+namespace splay {
+
+// Value stored in a node next to its key.
+template<typename V>
+class NodeValue {
+  public:
+    V value;
+
+    template<typename... Args>
+    explicit NodeValue(Args&&... args) : value(std::forward<Args>(args)...) {}
+};
+
+// Trees without values are sets; the empty base takes no space in the node.
+template<>
+class NodeValue<void> {};
+
 // A node of the tree
-class Node {
+template<typename K, typename V=void>
+class BasicNode : public NodeValue<V> {
   public:
-    int key;
-    Node* left;
-    Node* right;
-    Node* parent;
-
-    // Constructor
-    Node(int key, Node* parent=nullptr, Node* left=nullptr, Node* right=nullptr) {
-        this->key = key;
+    K key;
+    BasicNode* left;
+    BasicNode* right;
+    BasicNode* parent;
+
+    // Constructor; the extra arguments are used to construct the value.
+    template<typename... Args>
+    BasicNode(const K& key, BasicNode* parent=nullptr, BasicNode* left=nullptr, BasicNode* right=nullptr,
+              Args&&... value)
+        : NodeValue<V>(std::forward<Args>(value)...), key(key) {
         this->parent = parent;
         this->left = left;
         this->right = right;
@@ -17,21 +48,150 @@ class Node {
     }
 };
 
-// Binary tree
-class Tree {
+// Statistics hook of the splay trees. The trees inherit from it and call
+// count_rotation() on every rotation and count_splay() on every splay
+// operation. This one records nothing, so the calls compile to nothing.
+class NoStats {
+  public:
+    void count_rotation() {}
+    void count_splay() {}
+};
+
+// Splaying strategies decide how BasicTree restructures itself after
+// an access to a node at the given depth (the root has depth 0).
+
+// Standard splaying by zig-zig and zig-zag steps.
+class FullSplay {
+  public:
+    template<typename Tree>
+    void splay(Tree& tree, typename Tree::Node* node, unsigned) {
+        tree.splay(node);
+    }
+};
+
+// Naive splaying which uses only single rotations.
+class NaiveSplay {
+  public:
+    template<typename Tree>
+    void splay(Tree& tree, typename Tree::Node* node, unsigned) {
+        while (node->parent)
+            tree.rotate(node);
+    }
+};
+
+// Semi-splaying: a zig-zig step rotates only the parent and continues from it,
+// so the access path is roughly halved but the node need not reach the root.
+// It performs fewer rotations than splaying for the same amortized bounds.
+class SemiSplay {
+  public:
+    template<typename Tree>
+    void splay(Tree& tree, typename Tree::Node* node, unsigned) {
+        typename Tree::Node* parent;
+        while ((parent = node->parent) && parent->parent) {
+            if ((parent->right == node) == (parent->parent->right == parent)) {
+                // zigzig
+                tree.rotate(parent);
+                node = parent;
+            } else {
+                // zigzag
+                tree.rotate(node);
+                tree.rotate(node);
+            }
+        }
+
+        if (node->parent)
+            tree.rotate(node);
+    }
+};
+
+// Splay only nodes deeper than Threshold; shallow hits leave the tree untouched.
+template<unsigned Threshold>
+class DepthSplay {
+  public:
+    template<typename Tree>
+    void splay(Tree& tree, typename Tree::Node* node, unsigned depth) {
+        if (depth > Threshold)
+            tree.splay(node);
+    }
+};
+
+// Splay with probability Percent/100, leave the tree untouched otherwise.
+template<unsigned Percent>
+class RandomSplay {
+    // State of the xorshift64 generator
+    uint64_t state = 0x9e3779b97f4a7c15;
+
+  public:
+    template<typename Tree>
+    void splay(Tree& tree, typename Tree::Node* node, unsigned) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (state % 100 < Percent)
+            tree.splay(node);
+    }
+};
+
+// Binary tree mapping keys of type K to values of type V (a set if V is void).
+// Keys are ordered by Compare, Stats is the statistics hook and Strategy
+// the splaying strategy used by lookup, insert and remove.
+template<typename K=int, typename V=void, typename Compare=std::less<K>,
+         typename Stats=NoStats, typename Strategy=FullSplay>
+class BasicTree : public Stats {
+  public:
+    typedef BasicNode<K, V> Node;
+
+  private:
+    Compare less;
+    Strategy strategy;
+
+    // Restructure the tree after an access to the given node at the given depth.
+    void access(Node* node, unsigned depth) {
+        this->count_splay();
+        strategy.splay(*this, node, depth);
+    }
+
   public:
     // Pointer to root of the tree; nullptr if the tree is empty.
     Node* root;
 
-    Tree(Node* root=nullptr) {
+    BasicTree(Node* root=nullptr, const Compare& less=Compare()) : less(less) {
         this->root = root;
     }
 
+    // Trees own their nodes, so they can be moved but not copied.
+    BasicTree(const BasicTree&) = delete;
+    BasicTree& operator=(const BasicTree&) = delete;
+
+    BasicTree(BasicTree&& other) : Stats(std::move(other)), less(other.less), strategy(other.strategy) {
+        root = other.root;
+        other.root = nullptr;
+    }
+
+    BasicTree& operator=(BasicTree&& other) {
+        if (this != &other) {
+            clear();
+            Stats::operator=(std::move(other));
+            less = other.less;
+            strategy = other.strategy;
+            root = other.root;
+            other.root = nullptr;
+        }
+        return *this;
+    }
+
+    // Move the key and the value of node `from` to node `to`.
+    static void move_contents(Node* to, Node* from) {
+        to->key = std::move(from->key);
+        static_cast<NodeValue<V>&>(*to) = std::move(static_cast<NodeValue<V>&>(*from));
+    }
+
     // Rotate the given `node` up. Perform a single rotation of the edge
     // between the node and its parent, choosing left or right rotation
     // appropriately.
-    virtual void rotate(Node* node) {
+    void rotate(Node* node) {
         if (node->parent) {
+            this->count_rotation();
             if (node->parent->left == node) {
                 if (node->right) node->right->parent = node->parent;
                 node->parent->left = node->right;
@@ -56,70 +216,109 @@ class Tree {
         }
     }
 
+    // Find the node with the given key without splaying, return nullptr
+    // if there is none. It does not modify the tree, so it is safe to call
+    // concurrently with other calls of find().
+    Node* find(const K& key) const {
+        Node* node = root;
+        while (node) {
+            if (less(key, node->key))
+                node = node->left;
+            else if (less(node->key, key))
+                node = node->right;
+            else
+                return node;
+        }
+        return nullptr;
+    }
+
     // Look up the given key in the tree, returning the
     // the node with the requested key or nullptr.
-    Node* lookup(int key) {
+    Node* lookup(const K& key) {
         Node* node = root, *splayed = nullptr;
+        unsigned depth = 0;
         while (node) {
             splayed = node;
 
-            if (node->key == key) {
-                splay(node);
-                return node;
-            }
-            if (key < node->key)
+            if (less(key, node->key))
                 node = node->left;
-            else
+            else if (less(node->key, key))
                 node = node->right;
+            else {
+                access(node, depth);
+                return node;
+            }
+            depth++;
         }
 
         if (splayed)
-            splay(splayed);
+            access(splayed, depth - 1);
         return nullptr;
     }
 
-    // Insert a key into the tree.
+    // Insert a key into the tree and return its node.
+    // The extra arguments are used to construct the value.
     // If the key is already present, nothing happens.
-    void insert(int key) {
-        if (!root) {
-            root = new Node(key);
-            return;
-        }
+    template<typename... Args>
+    Node* insert(const K& key, Args&&... value) {
+        if (!root)
+            return root = new Node(key, nullptr, nullptr, nullptr, std::forward<Args>(value)...);
 
         Node* node = root;
-        while (node->key != key) {
-            if (key < node->key) {
-                if (!node->left)
-                    node->left = new Node(key, node);
+        unsigned depth = 0;
+        while (true) {
+            depth++;
+            if (less(key, node->key)) {
+                if (!node->left) {
+                    node->left = new Node(key, node, nullptr, nullptr, std::forward<Args>(value)...);
+                    node = node->left;
+                    break;
+                }
                 node = node->left;
-            } else {
-                if (!node->right)
-                    node->right = new Node(key, node);
+            } else if (less(node->key, key)) {
+                if (!node->right) {
+                    node->right = new Node(key, node, nullptr, nullptr, std::forward<Args>(value)...);
+                    node = node->right;
+                    break;
+                }
                 node = node->right;
+            } else {
+                depth--;
+                break;
             }
         }
 
-        splay(node);
+        access(node, depth);
+        return node;
     }
 
     // Delete given key from the tree.
     // It the key is not present, nothing happens.
-    void remove(int key) {
+    void remove(const K& key) {
         Node* node = root, *splayed = nullptr;
-        while (node && node->key != key) {
-            splayed = node;
-            if (key < node->key)
+        unsigned depth = 0;
+        while (node) {
+            if (less(key, node->key)) {
+                splayed = node;
                 node = node->left;
-            else
+            } else if (less(node->key, key)) {
+                splayed = node;
                 node = node->right;
+            } else {
+                break;
+            }
+            depth++;
         }
 
         if (node) {
             if (node->left && node->right) {
                 Node* replacement = node->right;
-                while (replacement->left)
+                depth++;
+                while (replacement->left) {
                     replacement = replacement->left;
-                node->key = replacement->key;
+                    depth++;
+                }
+                move_contents(node, replacement);
                 node = replacement;
             }
 
@@ -140,14 +339,15 @@ class Tree {
             delete node;
         }
 
+        // The splayed node is the parent of the deleted node or of the missing key.
         if (splayed)
-            splay(splayed);
+            access(splayed, depth - 1);
     }
 
     // Splay the given node.
     // If a single rotation needs to be performed, perform it as the last rotation
     // (i.e., to move the splayed node to the root of the tree).
-    virtual void splay(Node* node) {
+    void splay(Node* node) {
         Node* parent;
         while ((parent = node->parent) && parent->parent) {
             if (((parent->right == node) && (parent->parent->right == parent)) ||
@@ -168,8 +368,83 @@ class Tree {
         root = node;
     }
 
-    // Destructor to free all allocated memory.
-    ~Tree() {
+    // Split the tree: keys less than the given one stay in this tree,
+    // the others are moved to the returned tree.
+    BasicTree split(const K& key) {
+        return split(key, false);
+    }
+
+    // Like split(key), but if `keep_equal` is set, also the given key stays
+    // in this tree, i.e., the tree is split at its successor.
+    BasicTree split(const K& key, bool keep_equal) {
+        BasicTree right(nullptr, less);
+        if (!root)
+            return right;
+
+        // Splay the node with the key, or the last node on the search path,
+        // which is the predecessor or the successor of the key.
+        Node* node = root, *last = nullptr;
+        while (node) {
+            last = node;
+            if (less(key, node->key))
+                node = node->left;
+            else if (less(node->key, key))
+                node = node->right;
+            else
+                break;
+        }
+        this->count_splay();
+        splay(last);
+
+        if (less(root->key, key) || (keep_equal && !less(key, root->key))) {
+            right.root = root->right;
+            root->right = nullptr;
+        } else {
+            right.root = root;
+            root = root->left;
+            right.root->left = nullptr;
+        }
+
+        if (root)
+            root->parent = nullptr;
+        if (right.root)
+            right.root->parent = nullptr;
+        return right;
+    }
+
+    // Append all nodes of the other tree, whose keys must be all greater
+    // than the keys in this tree. The other tree becomes empty.
+    void join(BasicTree&& other) {
+        if (!other.root)
+            return;
+
+        if (root) {
+            // Splay the maximum, it has no right child then.
+            Node* node = root;
+            while (node->right)
+                node = node->right;
+            this->count_splay();
+            splay(node);
+
+            root->right = other.root;
+            other.root->parent = root;
+        } else {
+            root = other.root;
+        }
+        other.root = nullptr;
+    }
+
+    // Delete all keys k such that lo <= k <= hi.
+    // Besides freeing the k deleted nodes, this costs just two splits
+    // and a join, i.e., O(log n) amortized.
+    void remove_range(const K& lo, const K& hi) {
+        BasicTree middle = split(lo);
+        BasicTree right = middle.split(hi, true);
+        join(std::move(right));
+    }
+
+    // Delete all nodes.
+    void clear() {
         Node* node = root;
         while (node) {
             Node* next;
@@ -185,5 +460,464 @@ class Tree {
             }
             node = next;
         }
+        root = nullptr;
+    }
+
+    // Destructor to free all allocated memory.
+    ~BasicTree() {
+        clear();
+    }
+};
+
+typedef BasicTree<> Tree;
+typedef Tree::Node Node;
+
+// A node of the top-down splay tree; it needs no parent pointer.
+template<typename K, typename V=void>
+class BasicTopDownNode : public NodeValue<V> {
+  public:
+    K key;
+    BasicTopDownNode* left;
+    BasicTopDownNode* right;
+
+    // Constructor; the extra arguments are used to construct the value.
+    template<typename... Args>
+    BasicTopDownNode(const K& key, BasicTopDownNode* left=nullptr, BasicTopDownNode* right=nullptr,
+                     Args&&... value)
+        : NodeValue<V>(std::forward<Args>(value)...), key(key) {
+        this->left = left;
+        this->right = right;
     }
 };
+
+// Splay tree with top-down splaying
+//
+// Offers the same lookup/insert/remove semantics as BasicTree, but splay()
+// restructures the tree in a single pass down the access path: nodes
+// passed on the way are hung on the left and right trees and reassembled
+// under the splayed node at the end. No node is visited twice and no parent
+// pointers need to be maintained.
+//
+// Every rotation and every link is reported to Stats as a rotation, so the
+// counts match the depth of the splayed node like in BasicTree.
+template<typename K=int, typename V=void, typename Compare=std::less<K>, typename Stats=NoStats>
+class BasicTopDownTree : public Stats {
+    Compare less;
+
+  public:
+    typedef BasicTopDownNode<K, V> Node;
+
+    // Pointer to root of the tree; nullptr if the tree is empty.
+    Node* root;
+
+    BasicTopDownTree(Node* root=nullptr, const Compare& less=Compare()) : less(less) {
+        this->root = root;
+    }
+
+    // Trees own their nodes, so they can be moved but not copied.
+    BasicTopDownTree(const BasicTopDownTree&) = delete;
+    BasicTopDownTree& operator=(const BasicTopDownTree&) = delete;
+
+    BasicTopDownTree(BasicTopDownTree&& other) : Stats(std::move(other)), less(other.less) {
+        root = other.root;
+        other.root = nullptr;
+    }
+
+    BasicTopDownTree& operator=(BasicTopDownTree&& other) {
+        if (this != &other) {
+            clear();
+            Stats::operator=(std::move(other));
+            less = other.less;
+            root = other.root;
+            other.root = nullptr;
+        }
+        return *this;
+    }
+
+    // Splay the node with the given key to the root. If the key is not present,
+    // the last node on the search path (its predecessor or successor) is splayed.
+    void splay(const K& key) {
+        Node* node = root;
+        if (!node)
+            return;
+
+        this->count_splay();
+
+        // Roots of the left and right trees and the slots where the next nodes
+        // are to be linked: right child of the maximum of the left tree
+        // and left child of the minimum of the right tree.
+        Node* left = nullptr, *right = nullptr;
+        Node** left_max = &left, **right_min = &right;
+
+        while (true) {
+            if (less(key, node->key)) {
+                if (!node->left)
+                    break;
+                if (less(key, node->left->key)) {
+                    // zigzig: rotate right
+                    Node* child = node->left;
+                    node->left = child->right;
+                    child->right = node;
+                    node = child;
+                    this->count_rotation();
+                    if (!node->left)
+                        break;
+                }
+                // link right
+                this->count_rotation();
+                *right_min = node;
+                right_min = &node->left;
+                node = node->left;
+            } else if (less(node->key, key)) {
+                if (!node->right)
+                    break;
+                if (less(node->right->key, key)) {
+                    // zigzig: rotate left
+                    Node* child = node->right;
+                    node->right = child->left;
+                    child->left = node;
+                    node = child;
+                    this->count_rotation();
+                    if (!node->right)
+                        break;
+                }
+                // link left
+                this->count_rotation();
+                *left_max = node;
+                left_max = &node->right;
+                node = node->right;
+            } else {
+                break;
+            }
+        }
+
+        // assemble
+        *left_max = node->left;
+        *right_min = node->right;
+        node->left = left;
+        node->right = right;
+        root = node;
+    }
+
+    // Look up the given key in the tree, returning the
+    // the node with the requested key or nullptr.
+    Node* lookup(const K& key) {
+        splay(key);
+        if (root && !less(key, root->key) && !less(root->key, key))
+            return root;
+        return nullptr;
+    }
+
+    // Insert a key into the tree and return its node.
+    // The extra arguments are used to construct the value.
+    // If the key is already present, nothing happens.
+    template<typename... Args>
+    Node* insert(const K& key, Args&&... value) {
+        if (!root)
+            return root = new Node(key, nullptr, nullptr, std::forward<Args>(value)...);
+
+        splay(key);
+        if (less(key, root->key)) {
+            root = new Node(key, root->left, root, std::forward<Args>(value)...);
+            root->right->left = nullptr;
+        } else if (less(root->key, key)) {
+            root = new Node(key, root, root->right, std::forward<Args>(value)...);
+            root->left->right = nullptr;
+        }
+        return root;
+    }
+
+    // Delete given key from the tree.
+    // It the key is not present, nothing happens.
+    void remove(const K& key) {
+        if (!lookup(key))
+            return;
+
+        Node* node = root;
+        if (node->left) {
+            // All keys on the left are smaller, so their maximum is splayed.
+            root = node->left;
+            splay(key);
+            root->right = node->right;
+        } else {
+            root = node->right;
+        }
+        delete node;
+    }
+
+    // Delete all nodes.
+    void clear() {
+        // Rotate left children up until the root has none, then delete it.
+        while (root) {
+            Node* node = root;
+            if (node->left) {
+                root = node->left;
+                node->left = root->right;
+                root->right = node;
+            } else {
+                root = node->right;
+                delete node;
+            }
+        }
+    }
+
+    // Destructor to free all allocated memory.
+    ~BasicTopDownTree() {
+        clear();
+    }
+};
+
+typedef BasicTopDownTree<> TopDownTree;
+
+// Splay tree with nodes in a pool and 32-bit links
+//
+// Nodes live in one array and refer to each other by indices into it, so an
+// int set needs 16 bytes per node instead of 32 bytes plus the malloc header.
+// Deleted nodes are put on a free list and reused by the next inserts,
+// so a long-running tree does not fragment the heap. Index can be widened
+// for trees with 2^32 or more nodes.
+//
+// Splaying and the lookup/insert/remove semantics are the same as in BasicTree.
+// Pointers to nodes are valid only until the next insert.
+template<typename K=int, typename V=void, typename Compare=std::less<K>,
+         typename Stats=NoStats, typename Index=uint32_t>
+class BasicCompactTree : public Stats {
+  public:
+    // Index of no node
+    static constexpr Index NIL = ~Index(0);
+
+    class Node : public NodeValue<V> {
+      public:
+        K key;
+        Index left;
+        Index right;
+        Index parent;   // Next node on the free list for deleted nodes
+
+        template<typename... Args>
+        Node(const K& key, Index parent, Args&&... value)
+            : NodeValue<V>(std::forward<Args>(value)...), key(key), left(NIL), right(NIL), parent(parent) {}
+    };
+
+    // Index of root of the tree; NIL if the tree is empty.
+    Index root = NIL;
+
+  private:
+    Compare less;
+    std::vector<Node> nodes;
+    Index free_list = NIL;
+
+    Node& at(Index i) {
+        return nodes[i];
+    }
+
+    // Create a node from the free list or at the end of the pool.
+    template<typename... Args>
+    Index create(const K& key, Index parent, Args&&... value) {
+        if (free_list == NIL) {
+            // Index NIL is reserved; past it, indices would wrap around.
+            assert(nodes.size() < NIL && "Too many nodes, widen Index");
+            nodes.emplace_back(key, parent, std::forward<Args>(value)...);
+            return nodes.size() - 1;
+        }
+
+        Index i = free_list;
+        free_list = at(i).parent;
+        at(i) = Node(key, parent, std::forward<Args>(value)...);
+        return i;
+    }
+
+    // Put a node on the free list. Its value is reset right away,
+    // so that resources it owns are not held until the node is reused.
+    void destroy(Index i) {
+        static_cast<NodeValue<V>&>(at(i)) = NodeValue<V>();
+        at(i).parent = free_list;
+        free_list = i;
+    }
+
+  public:
+    explicit BasicCompactTree(const Compare& less=Compare()) : less(less) {}
+
+    // Node with the given index.
+    Node* node(Index i) {
+        return i == NIL ? nullptr : &at(i);
+    }
+
+    const Node* node(Index i) const {
+        return i == NIL ? nullptr : &nodes[i];
+    }
+
+    // Memory taken by the pool in bytes.
+    std::size_t memory_usage() const {
+        return nodes.capacity() * sizeof(Node);
+    }
+
+    // Rotate the node with index `i` up. Perform a single rotation of the edge
+    // between the node and its parent, choosing left or right rotation
+    // appropriately.
+    void rotate(Index i) {
+        Node& node = at(i);
+        if (node.parent == NIL)
+            return;
+
+        this->count_rotation();
+        Index p = node.parent;
+        Node& parent = at(p);
+        if (parent.left == i) {
+            if (node.right != NIL) at(node.right).parent = p;
+            parent.left = node.right;
+            node.right = p;
+        } else {
+            if (node.left != NIL) at(node.left).parent = p;
+            parent.right = node.left;
+            node.left = p;
+        }
+
+        Index g = parent.parent;
+        if (g != NIL) {
+            if (at(g).left == p)
+                at(g).left = i;
+            else
+                at(g).right = i;
+        } else {
+            root = i;
+        }
+
+        node.parent = g;
+        parent.parent = i;
+    }
+
+    // Splay the node with index `i`.
+    void splay(Index i) {
+        Index p, g;
+        while ((p = at(i).parent) != NIL && (g = at(p).parent) != NIL) {
+            if ((at(p).right == i) == (at(g).right == p)) {
+                // zigzig
+                rotate(p);
+                rotate(i);
+            } else {
+                // zigzag
+                rotate(i);
+                rotate(i);
+            }
+        }
+
+        if (at(i).parent != NIL)
+            rotate(i);
+
+        root = i;
+    }
+
+    // Look up the given key in the tree, returning the
+    // the node with the requested key or nullptr.
+    Node* lookup(const K& key) {
+        Index i = root, splayed = NIL;
+        while (i != NIL) {
+            splayed = i;
+
+            if (less(key, at(i).key))
+                i = at(i).left;
+            else if (less(at(i).key, key))
+                i = at(i).right;
+            else
+                break;
+        }
+
+        if (splayed == NIL)
+            return nullptr;
+        this->count_splay();
+        splay(splayed);
+        return node(i);
+    }
+
+    // Insert a key into the tree and return its node.
+    // The extra arguments are used to construct the value.
+    // If the key is already present, nothing happens.
+    template<typename... Args>
+    Node* insert(const K& key, Args&&... value) {
+        if (root == NIL) {
+            root = create(key, NIL, std::forward<Args>(value)...);
+            return node(root);
+        }
+
+        Index i = root;
+        while (true) {
+            if (less(key, at(i).key)) {
+                if (at(i).left == NIL) {
+                    Index child = create(key, i, std::forward<Args>(value)...);
+                    i = at(i).left = child;
+                    break;
+                }
+                i = at(i).left;
+            } else if (less(at(i).key, key)) {
+                if (at(i).right == NIL) {
+                    Index child = create(key, i, std::forward<Args>(value)...);
+                    i = at(i).right = child;
+                    break;
+                }
+                i = at(i).right;
+            } else {
+                break;
+            }
+        }
+
+        this->count_splay();
+        splay(i);
+        return node(i);
+    }
+
+    // Delete given key from the tree.
+    // It the key is not present, nothing happens.
+    void remove(const K& key) {
+        Index i = root, splayed = NIL;
+        while (i != NIL) {
+            if (less(key, at(i).key)) {
+                splayed = i;
+                i = at(i).left;
+            } else if (less(at(i).key, key)) {
+                splayed = i;
+                i = at(i).right;
+            } else {
+                break;
+            }
+        }
+
+        if (i != NIL) {
+            if (at(i).left != NIL && at(i).right != NIL) {
+                Index replacement = at(i).right;
+                while (at(replacement).left != NIL)
+                    replacement = at(replacement).left;
+                at(i).key = std::move(at(replacement).key);
+                static_cast<NodeValue<V>&>(at(i)) = std::move(static_cast<NodeValue<V>&>(at(replacement)));
+                i = replacement;
+            }
+
+            Index replacement = at(i).left != NIL ? at(i).left : at(i).right;
+            Index p = at(i).parent;
+            if (p != NIL) {
+                if (at(p).left == i)
+                    at(p).left = replacement;
+                else
+                    at(p).right = replacement;
+            } else {
+                root = replacement;
+            }
+
+            if (replacement != NIL)
+                at(replacement).parent = p;
+
+            splayed = p;
+            destroy(i);
+        }
+
+        if (splayed != NIL) {
+            this->count_splay();
+            splay(splayed);
+        }
+    }
+};
+
+typedef BasicCompactTree<> CompactTree;
+
+}  // namespace splay
+
+#endif
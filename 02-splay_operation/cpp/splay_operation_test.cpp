@@ -1,24 +1,31 @@
 #include <algorithm>
+#include <cstdint>
 #include <cassert>
 #include <fstream>
 #include <functional>
+#include <memory>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "splay_operation.h"
+#include "sharded_tree.h"
 
 using namespace std;
+using namespace splay;
 
 // If the condition is not true, report an error and halt.
 #define EXPECT(condition, message) do { if (!(condition)) expect_failed(message); } while (0)
 void expect_failed(const string& message);
 
 // Flatten the tree: return a sorted list of all keys in the tree.
-vector<int> flatten(const Tree& tree) {
+template<typename T>
+vector<int> flatten(const T& tree) {
     constexpr int L = 0, R = 1, F = 2;
 
-    Node* node = tree.root;
+    auto node = tree.root;
     vector<int> flattened, stack = {L};
     while (!stack.empty()) {
         if (stack.back() == L) {
@@ -42,6 +49,43 @@ vector<int> flatten(const Tree& tree) {
     return flattened;
 }
 
+// Flatten a tree without parent pointers.
+template<typename K, typename V, typename Compare, typename Stats>
+vector<int> flatten(const BasicTopDownTree<K, V, Compare, Stats>& tree) {
+    auto node = tree.root;
+    vector<int> flattened;
+    vector<decltype(node)> stack;
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        flattened.push_back(node->key);
+        node = node->right;
+    }
+    return flattened;
+}
+
+// Flatten a tree with index links.
+vector<int> flatten(const CompactTree& tree) {
+    uint32_t node = tree.root;
+    vector<int> flattened;
+    vector<uint32_t> stack;
+    while (node != CompactTree::NIL || !stack.empty()) {
+        while (node != CompactTree::NIL) {
+            stack.push_back(node);
+            node = tree.node(node)->left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        flattened.push_back(tree.node(node)->key);
+        node = tree.node(node)->right;
+    }
+    return flattened;
+}
+
 // Test for splay operation with required helpers
 class TestSplay {
   public:
@@ -107,9 +151,10 @@ class TestSplay {
     }
 };
 
+template<typename T>
 void test_lookup() {
     // Insert even numbers
-    Tree tree;
+    T tree;
     for (int i = 0; i < 5000000; i += 2)
         tree.insert(i);
 
@@ -124,10 +169,11 @@ void test_lookup() {
             EXPECT(tree.lookup(i), "Existing element was not found");
 }
 
+template<typename T>
 void test_insert() {
     // Test validity first
     {
-        Tree tree;
+        T tree;
         vector<int> sequence = {997};
         for (int i = 2; i < 1999; i++)
             sequence.push_back((sequence.back() * sequence.front()) % 1999);
@@ -141,17 +187,18 @@ void test_insert() {
 
     // Test speed
     {
-        Tree tree;
+        T tree;
         for (int i = 0; i < 5000000; i++)
             for (int j = 0; j < 10; j++)
                 tree.insert(i);
     }
 }
 
+template<typename T>
 void test_remove() {
     // Test validity first
     {
-        Tree tree;
+        T tree;
         for (int i = 2; i < 1999 * 2; i++)
             tree.insert(i);
 
@@ -168,7 +215,7 @@ void test_remove() {
 
     // Test speed
     {
-        Tree tree;
+        T tree;
         for (int i = 0; i < 5000000; i++)
             tree.insert(i);
 
@@ -184,9 +231,265 @@ void test_remove() {
     }
 }
 
+void test_key_value() {
+    // Map 64-bit keys to strings, ordered from the largest key.
+    BasicTree<uint64_t, string, greater<uint64_t>> tree;
+    constexpr int n = 19999;
+    for (int i = 0; i < n; i++) {
+        uint64_t key = ((i * uint64_t(997)) % n) << 32;
+        auto node = tree.insert(key, to_string(key));
+        EXPECT(node == tree.root && node->value == to_string(key), "Wrong node returned by insert");
+        EXPECT(tree.insert(key, "duplicate")->value == to_string(key), "Duplicate key was inserted");
+    }
+
+    // Remove odd keys; removing nodes with two children must move their values.
+    for (int i = 1; i < n; i += 2)
+        tree.remove(uint64_t(i) << 32);
+
+    for (int i = 0; i < n; i++) {
+        uint64_t key = uint64_t(i) << 32;
+        auto node = tree.lookup(key);
+        if (i % 2)
+            EXPECT(!node, "Removed key was found");
+        else
+            EXPECT(node && node->value == to_string(key), "Value of key " + to_string(key) + " was lost");
+        EXPECT(!tree.lookup(key + 1), "Non-existing key was found");
+    }
+
+    auto node = tree.root;
+    while (node->left)
+        node = node->left;
+    EXPECT(node->key == uint64_t(n - 1) << 32, "Keys are not ordered by the comparator");
+}
+
+// Check lookup, insert and remove with the given splaying strategy.
+template<typename Strategy>
+void test_strategy() {
+    BasicTree<int, void, less<int>, NoStats, Strategy> tree;
+    vector<int> sequence = {997};
+    for (int i = 2; i < 199999; i++)
+        sequence.push_back((sequence.back() * int64_t(sequence.front())) % 199999);
+    for (const auto& i : sequence)
+        tree.insert(2 * i);
+
+    for (const auto& i : sequence) {
+        EXPECT(tree.lookup(2 * i), "Existing element was not found");
+        EXPECT(!tree.lookup(2 * i + 1), "Non-existing element was found");
+    }
+
+    for (const auto& i : sequence)
+        if (i % 3)
+            tree.remove(2 * i);
+
+    vector<int> expected;
+    for (int i = 0; i < 199999; i += 3)
+        if (i)
+            expected.push_back(2 * i);
+    EXPECT(flatten(tree) == expected, "Incorrect tree after a sequence of removes");
+}
+
+void test_split_join() {
+    constexpr int n = 19999;
+    vector<int> sequence;
+    for (int i = 0; i < n; i++)
+        sequence.push_back((i * int64_t(997)) % n);
+
+    for (int key = -1; key <= n; key += 1 + key / 3) {
+        Tree tree;
+        for (const auto& i : sequence)
+            tree.insert(2 * i);
+
+        // Split by both present and missing keys.
+        Tree right = tree.split(key);
+        vector<int> expected_left, expected_right;
+        for (int i = 0; i < n; i++)
+            (2 * i < key ? expected_left : expected_right).push_back(2 * i);
+        EXPECT((tree.root ? flatten(tree) : vector<int>()) == expected_left,
+               "Wrong left tree after split at " + to_string(key));
+        EXPECT((right.root ? flatten(right) : vector<int>()) == expected_right,
+               "Wrong right tree after split at " + to_string(key));
+
+        tree.join(std::move(right));
+        EXPECT(!right.root, "Joined tree is not empty");
+        vector<int> expected;
+        for (int i = 0; i < n; i++)
+            expected.push_back(2 * i);
+        EXPECT(flatten(tree) == expected, "Wrong tree after join at " + to_string(key));
+
+        // Both bounds are inclusive; they hit present keys for even `key`.
+        tree.remove_range(key, key + 1000);
+        expected.erase(remove_if(expected.begin(), expected.end(),
+                                 [key](int k) { return k >= key && k <= key + 1000; }),
+                       expected.end());
+        EXPECT(flatten(tree) == expected, "Wrong tree after removing range from " + to_string(key));
+        for (int i = 0; i < n; i++)
+            EXPECT(!tree.lookup(2 * i) == (2 * i >= key && 2 * i <= key + 1000),
+                   "Wrong lookup result after removing range from " + to_string(key));
+    }
+}
+
+void test_sharded() {
+    constexpr int num_threads = 8, n = 200000;
+    vector<int> bounds;
+    for (int i = 1; i < 16; i++)
+        bounds.push_back(i * n / 16);
+    ShardedTree<int, int> tree(bounds);
+    EXPECT(tree.size() == 16, "Wrong number of shards");
+
+    // Every thread inserts its residue class, looks up everything
+    // and removes the multiples of 3 from its class.
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; t++)
+        threads.emplace_back([&tree, t] {
+            for (int i = t; i < n; i += num_threads)
+                tree.insert(i, -i);
+            for (int i = 0; i < n; i++) {
+                int value = 0;
+                if (tree.lookup(i, [&value](const ShardedTree<int, int>::Node& node) { value = node.value; }))
+                    EXPECT(value == -i, "Wrong value found in a sharded tree");
+            }
+            for (int i = t; i < n; i += num_threads)
+                if (i % 3 == 0)
+                    tree.remove(i);
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (int i = -10; i < n + 10; i++)
+        EXPECT(tree.lookup(i) == (i >= 0 && i < n && i % 3 != 0), "Sharded tree contains wrong keys");
+}
+
+// Keys equal modulo 10 are equivalent.
+struct LastDigitLess {
+    bool operator()(int x, int y) const { return x % 10 < y % 10; }
+};
+
+// Shards must store keys by the same comparator which routes them.
+void test_sharded_comparator() {
+    ShardedTree<int, void, LastDigitLess> tree({3, 7});
+    for (int i = 0; i < 10; i++)
+        tree.insert(i);
+    for (int i = 10; i < 100; i++)
+        EXPECT(tree.lookup(i), "Shard does not use the comparator of the tree");
+}
+
+// Deleted nodes of the compact tree must be reused.
+void test_compact_reuse() {
+    CompactTree tree;
+    for (int i = 0; i < 100000; i++)
+        tree.insert(i);
+    size_t memory = tree.memory_usage();
+
+    for (int round = 0; round < 10; round++) {
+        for (int i = round % 2; i < 100000; i += 2)
+            tree.remove(i);
+        for (int i = 100000 + round; i < 250000; i += 3)
+            tree.insert(i);
+        for (int i = 100000 + round; i < 250000; i += 3)
+            tree.remove(i);
+        for (int i = round % 2; i < 100000; i += 2)
+            tree.insert(i);
+    }
+    EXPECT(tree.memory_usage() == memory, "Deleted nodes were not reused");
+
+    vector<int> expected;
+    for (int i = 0; i < 100000; i++)
+        expected.push_back(i);
+    EXPECT(flatten(tree) == expected, "Incorrect tree after reusing nodes");
+}
+
+// A comparator whose ordering is chosen at run time.
+struct DirectedLess {
+    bool reverse = false;
+
+    bool operator()(int x, int y) const { return reverse ? y < x : x < y; }
+};
+
+// Statistics counting the splays.
+struct SplayCount {
+    long splays = 0;
+
+    void count_rotation() {}
+    void count_splay() { splays++; }
+};
+
+// Trees own their nodes: moving transfers them together with the comparator
+// and the statistics, copying must not compile.
+template<typename T>
+void test_move() {
+    static_assert(!is_copy_constructible<T>::value && !is_copy_assignable<T>::value,
+                  "Trees must not be copyable");
+
+    DirectedLess reverse;
+    reverse.reverse = true;
+    T tree(nullptr, reverse);
+    vector<int> expected;
+    for (int i = 999; i >= 0; i--) {
+        tree.insert(i);
+        expected.push_back(i);
+    }
+    long splays = tree.splays;
+
+    T moved(std::move(tree));
+    EXPECT(!tree.root, "Moved-from tree is not empty");
+    EXPECT(flatten(moved) == expected, "Wrong tree after move construction");
+    EXPECT(moved.splays == splays, "Statistics were lost by move construction");
+
+    T assigned;
+    assigned.insert(-1);
+    assigned = std::move(moved);
+    EXPECT(!moved.root, "Moved-from tree is not empty");
+    EXPECT(flatten(assigned) == expected, "Wrong tree after move assignment");
+    EXPECT(assigned.splays == splays, "Statistics were lost by move assignment");
+
+    // The comparator must come along, too.
+    assigned.insert(1000);
+    expected.insert(expected.begin(), 1000);
+    EXPECT(flatten(assigned) == expected, "Comparator was lost by move assignment");
+}
+
+// Removing a key from the compact tree must release its value.
+void test_compact_release() {
+    BasicCompactTree<int, shared_ptr<int>> tree;
+    auto value = make_shared<int>(42);
+    for (int i = 0; i < 100; i++)
+        tree.insert(i, value);
+    for (int i = 0; i < 100; i++)
+        tree.remove(i);
+    EXPECT(value.use_count() == 1, "Removed values are still alive");
+}
+
+// With 8-bit indices, all 255 indices below NIL must be usable.
+void test_compact_narrow() {
+    BasicCompactTree<int, void, less<int>, NoStats, uint8_t> tree;
+    for (int i = 0; i < 255; i++)
+        tree.insert(i);
+    for (int i = 0; i < 255; i++)
+        EXPECT(tree.lookup(i), "Key " + to_string(i) + " was lost");
+}
+
 vector<pair<string, function<void()>>> tests = {
     { "splay", TestSplay::test },
-    { "lookup", test_lookup },
-    { "insert", test_insert },
-    { "remove", test_remove },
+    { "lookup", test_lookup<Tree> },
+    { "insert", test_insert<Tree> },
+    { "remove", test_remove<Tree> },
+    { "topdown-lookup", test_lookup<TopDownTree> },
+    { "topdown-insert", test_insert<TopDownTree> },
+    { "topdown-remove", test_remove<TopDownTree> },
+    { "move", test_move<BasicTree<int, void, DirectedLess, SplayCount>> },
+    { "topdown-move", test_move<BasicTopDownTree<int, void, DirectedLess, SplayCount>> },
+    { "compact-lookup", test_lookup<CompactTree> },
+    { "compact-insert", test_insert<CompactTree> },
+    { "compact-remove", test_remove<CompactTree> },
+    { "compact-reuse", test_compact_reuse },
+    { "compact-narrow", test_compact_narrow },
+    { "compact-release", test_compact_release },
+    { "key_value", test_key_value },
+    { "naive", test_strategy<NaiveSplay> },
+    { "semi", test_strategy<SemiSplay> },
+    { "depth", test_strategy<DepthSplay<8>> },
+    { "random", test_strategy<RandomSplay<50>> },
+    { "split_join", test_split_join },
+    { "sharded", test_sharded },
+    { "sharded-comparator", test_sharded_comparator },
 };
@@ -0,0 +1 @@
+../../04-ab_tree/cpp/ab_tree.h
\ No newline at end of file
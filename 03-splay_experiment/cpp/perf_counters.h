@@ -0,0 +1,131 @@
+#ifndef DS1_PERF_COUNTERS_H
+#define DS1_PERF_COUNTERS_H
+
+#include <cstdint>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Hardware performance counters of the current thread, read via the Linux
+ * perf_event interface. Only user-space events are counted.
+ *
+ * The counters may be unavailable (other systems, missing permissions
+ * in kernel.perf_event_paranoid, virtual machines without a PMU);
+ * available() tells whether all of them could be opened.
+ */
+
+class PerfCounters {
+  public:
+    static constexpr int NUM_EVENTS = 4;
+
+    // Names of the events, in the order of value().
+    static const char *name(int i)
+    {
+        static const char *const names[NUM_EVENTS] = {
+            "cycles", "l1d_misses", "llc_misses", "branch_misses"
+        };
+        return names[i];
+    }
+
+  private:
+    int fds[NUM_EVENTS];
+    uint64_t totals[NUM_EVENTS];
+
+#ifdef __linux__
+    static int open_event(uint32_t type, uint64_t config)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+  public:
+    PerfCounters()
+    {
+#ifdef __linux__
+        fds[0] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[1] = open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                            (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        fds[2] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[3] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#else
+        for (int i=0; i<NUM_EVENTS; i++)
+            fds[i] = -1;
+#endif
+        reset();
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (int i=0; i<NUM_EVENTS; i++)
+            if (fds[i] >= 0)
+                close(fds[i]);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const
+    {
+        for (int i=0; i<NUM_EVENTS; i++)
+            if (fds[i] < 0)
+                return false;
+        return true;
+    }
+
+    // Zero the accumulated values.
+    void reset()
+    {
+        for (int i=0; i<NUM_EVENTS; i++)
+            totals[i] = 0;
+    }
+
+    // Start counting.
+    void start()
+    {
+#ifdef __linux__
+        for (int i=0; i<NUM_EVENTS; i++)
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    // Stop counting and add the counts since start() to the accumulated values.
+    void stop()
+    {
+#ifdef __linux__
+        for (int i=0; i<NUM_EVENTS; i++)
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t count;
+                if (read(fds[i], &count, sizeof(count)) == sizeof(count))
+                    totals[i] += count;
+            }
+#endif
+    }
+
+    // Accumulated value of the i-th event.
+    uint64_t value(int i) const
+    {
+        return totals[i];
+    }
+};
+
+#endif
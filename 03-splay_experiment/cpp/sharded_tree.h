@@ -0,0 +1 @@
+../../02-splay_operation/cpp/sharded_tree.h
\ No newline at end of file
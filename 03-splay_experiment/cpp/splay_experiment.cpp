@@ -5,33 +5,41 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include "splay_operation.h"
 #include "random.h"
+#include "zipf.h"
+#include "perf_counters.h"
 
 using namespace std;
+using namespace splay;
 
 /*
- *  A modified Splay tree for benchmarking.
+ *  Statistics hook for benchmarking.
  *
- *  We inherit the implementation of operations from the Tree class
- *  and extend it by keeping statistics on the number of splay operations
- *  and the total number of rotations. Also, if naive is turned on,
- *  splay uses only single rotations.
- *
- *  Please make sure that your Tree class defines the rotate() and splay()
- *  methods as virtual.
+ *  The splay trees are parametrized by a statistics hook, which is called
+ *  on every splay operation and every rotation. The production trees use
+ *  NoStats, which compiles to nothing; here we keep statistics on the number
+ *  of splay operations and the total number of rotations.
  */
 
-class BenchmarkingTree : public Tree {
+class SplayCounters {
 public:
     int num_operations;
     int num_rotations;
-    bool do_naive;
 
-    BenchmarkingTree(bool naive=false)
+    SplayCounters()
     {
-        do_naive = naive;
         reset();
     }
 
@@ -41,21 +49,14 @@ public:
         num_rotations = 0;
     }
 
-    void rotate(Node *node) override
+    void count_rotation()
     {
         num_rotations++;
-        Tree::rotate(node);
     }
 
-    void splay(Node *node) override
+    void count_splay()
     {
         num_operations++;
-        if (do_naive) {
-            while (node->parent)
-                rotate(node);
-        } else {
-            Tree::splay(node);
-        }
     }
 
     // Return the average number of rotations per operation.
@@ -68,22 +69,105 @@ public:
     }
 };
 
-bool naive;             // Use of naive rotations requested
+// The benchmarked trees: splaying by one of the strategies from splay_operation.h,
+// top-down splaying and the pooled tree with 32-bit links.
+template<typename Strategy>
+using BenchmarkingTree = BasicTree<int, void, less<int>, SplayCounters, Strategy>;
+using TopDownBenchmarkingTree = BasicTopDownTree<int, void, less<int>, SplayCounters>;
+using CompactBenchmarkingTree = BasicCompactTree<int, void, less<int>, SplayCounters>;
+
 RandomGen *rng;         // Random generator object
+PerfCounters *perf;     // Hardware counters, nullptr unless requested
 
-void test_sequential()
+typedef chrono::steady_clock Clock;
+constexpr double MIN_TIME = .1;     // Minimum measured time per data point in seconds
+
+/*
+ *  The output is a table of numbers separated by spaces, one line per data
+ *  point. It starts with a comment line naming the columns: those describing
+ *  the data point, followed by the measured values:
+ *
+ *      rot_per_op      average number of rotations per splay
+ *      ns_per_op       average wall-clock time per operation
+ *      <event>_per_op  average count of a hardware event per operation
+ *                      (only if the counters were requested)
+ */
+void print_header(const string& columns)
 {
-    for (int n=100; n<=3000; n+=100) {
-        BenchmarkingTree tree = BenchmarkingTree(naive);
+    cout << "# " << columns << " rot_per_op ns_per_op";
+    if (perf)
+        for (int i=0; i<PerfCounters::NUM_EVENTS; i++)
+            cout << " " << PerfCounters::name(i) << "_per_op";
+    cout << endl;
+}
 
-        for (int x=0; x<n; x++)
-            tree.insert(x);
+// Print the measured values for one data point and finish its line.
+void print_values(double rot_per_op, double ns_per_op, double operations)
+{
+    cout << " " << rot_per_op << " " << ns_per_op;
+    if (perf)
+        for (int i=0; i<PerfCounters::NUM_EVENTS; i++)
+            cout << " " << perf->value(i) / operations;
+    cout << endl;
+}
+
+/*
+ *  Measure operations on a tree and print the measured values,
+ *  completing the line of output.
+ *
+ *  `prepare` sets up a fresh tree, then `run` performs the measured operations
+ *  and returns how many it performed. The rotations per splay are taken from
+ *  the first run. Runs on fresh trees are repeated until they take at least
+ *  MIN_TIME in total, which gives the wall-clock time and hardware events
+ *  per operation. Splays are not counted as operations, because the trees
+ *  splay different numbers of times per operation (e.g., top-down remove
+ *  splays twice).
+ */
+template<typename Tree>
+void measure(const function<void(Tree&)> &prepare, const function<long(Tree&)> &run)
+{
+    double rotations = -1;
+    double operations = 0;
+    chrono::duration<double, nano> elapsed(0);
+
+    if (perf)
+        perf->reset();
+    do {
+        Tree tree;
+        prepare(tree);
+        tree.reset();
+
+        if (perf)
+            perf->start();
+        auto start = Clock::now();
+        long performed = run(tree);
+        elapsed += Clock::now() - start;
+        if (perf)
+            perf->stop();
+
+        if (rotations < 0)
+            rotations = tree.rot_per_op();
+        operations += performed;
+    } while (elapsed.count() < MIN_TIME * 1e9);
 
-        for (int i=0; i<5; i++)
+    print_values(rotations, elapsed.count() / operations, operations);
+}
+
+template<typename Tree>
+void test_sequential()
+{
+    print_header("n");
+    for (int n=100; n<=3000; n+=100) {
+        cout << n;
+        measure<Tree>([](Tree &) {}, [n](Tree &tree) {
             for (int x=0; x<n; x++)
-                tree.lookup(x);
+                tree.insert(x);
 
-        cout << n << " " << tree.rot_per_op() << endl;
+            for (int i=0; i<5; i++)
+                for (int x=0; x<n; x++)
+                    tree.lookup(x);
+            return 6L * n;
+        });
     }
 }
 
@@ -98,20 +182,27 @@ vector<int> random_permutation(int n)
     return perm;
 }
 
+template<typename Tree>
 void test_random()
 {
+    print_header("n");
     for (int e=32; e<=64; e++) {
         int n = (int) pow(2, e/4.);
-        BenchmarkingTree tree = BenchmarkingTree(naive);
 
         vector<int> perm = random_permutation(n);
-        for (int x : perm)
-            tree.insert(x);
-
+        vector<int> queries;
         for (int i=0; i<5*n; i++)
-            tree.lookup(rng->next_range(n));
+            queries.push_back(rng->next_range(n));
+
+        cout << n;
+        measure<Tree>([](Tree &) {}, [&](Tree &tree) {
+            for (int x : perm)
+                tree.insert(x);
 
-        cout << n << " " << tree.rot_per_op() << endl;
+            for (int x : queries)
+                tree.lookup(x);
+            return (long) (perm.size() + queries.size());
+        });
     }
 }
 
@@ -127,6 +218,7 @@ void make_progression(vector<int> &seq, int A, int B, int s, int inc)
             swap(seq[i], seq[s + inc*(seq[i] - A)]);
 }
 
+template<typename Tree>
 void test_subset_s(int sub)
 {
     for (int e=32; e<=64; e++) {
@@ -142,38 +234,400 @@ void test_subset_s(int sub)
         make_progression(seq, 3*n/4, 3*n/4 + n/20, n/2, -4);
         make_progression(seq, 17*n/20, 17*n/20 + n/20, 2*n/5, 5);
 
-        BenchmarkingTree tree = BenchmarkingTree(naive);
-        for (int x : seq)
+        vector<int> queries;
+        for (int i=0; i<10000; i++)
+            queries.push_back(seq[rng->next_range(sub)]);
+
+        cout << sub << " " << n;
+        measure<Tree>([&](Tree &tree) {
+            for (int x : seq)
+                tree.insert(x);
+        }, [&](Tree &tree) {
+            for (int x : queries)
+                tree.lookup(x);
+            return (long) queries.size();
+        });
+    }
+}
+
+/*
+ *  Skewed and shifting workloads.
+ *
+ *  In all these tests, we insert n elements in random order and then perform
+ *  5n finds, whose distribution varies. Only the finds are measured.
+ *  The popularity of elements is independent of their order: the i-th most
+ *  popular element (or the i-th element of the working set) is perm[i]
+ *  for a random permutation perm.
+ */
+
+template<typename Tree>
+void measure_finds(const vector<int> &perm, const vector<int> &queries)
+{
+    measure<Tree>([&](Tree &tree) {
+        for (int x : perm)
             tree.insert(x);
-        tree.reset();
+    }, [&](Tree &tree) {
+        for (int x : queries)
+            tree.lookup(x);
+        return (long) queries.size();
+    });
+}
 
-        for (int i=0; i<10000; i++)
-            tree.lookup(seq[rng->next_range(sub)]);
+// Find elements with Zipf distribution with exponent s.
+template<typename Tree>
+void test_zipf_s(double s)
+{
+    for (int e=32; e<=64; e++) {
+        int n = (int) pow(2, e/4.);
+        vector<int> perm = random_permutation(n);
+        ZipfGen zipf(*rng, n, s);
+
+        vector<int> queries;
+        for (int i=0; i<5*n; i++)
+            queries.push_back(perm[zipf.next()]);
 
-        cout << sub << " " << n << " " << tree.rot_per_op() << endl;
+        cout << s << " " << n;
+        measure_finds<Tree>(perm, queries);
     }
 }
 
-void test_subset()
+template<typename Tree>
+void test_zipf()
+{
+    print_header("s n");
+    test_zipf_s<Tree>(0.8);
+    test_zipf_s<Tree>(1.0);
+    test_zipf_s<Tree>(1.2);
+}
+
+// Find random elements of a working set of size w, which slides
+// over all n elements during the test.
+template<typename Tree>
+void test_sliding_w(int w)
+{
+    for (int e=32; e<=64; e++) {
+        int n = (int) pow(2, e/4.);
+        if (n < w)
+          continue;
+        vector<int> perm = random_permutation(n);
+
+        vector<int> queries;
+        for (int i=0; i<5*n; i++) {
+            int start = i/5;
+            queries.push_back(perm[(start + rng->next_range(w)) % n]);
+        }
+
+        cout << w << " " << n;
+        measure_finds<Tree>(perm, queries);
+    }
+}
+
+template<typename Tree>
+void test_sliding()
+{
+    print_header("w n");
+    test_sliding_w<Tree>(10);
+    test_sliding_w<Tree>(100);
+    test_sliding_w<Tree>(1000);
+}
+
+/*
+ *  90% of finds go to a hot set of 100 elements, the rest to random elements.
+ *  After every `phase` finds, the hot set is replaced by a different one.
+ */
+template<typename Tree>
+void test_phases_p(int phase)
+{
+    const int hot = 100;
+
+    for (int e=32; e<=64; e++) {
+        int n = (int) pow(2, e/4.);
+        vector<int> perm = random_permutation(n);
+
+        vector<int> queries;
+        for (int i=0; i<5*n; i++) {
+            int first = (i/phase * hot) % (n - hot + 1);
+            if (rng->next_range(10))
+                queries.push_back(perm[first + rng->next_range(hot)]);
+            else
+                queries.push_back(rng->next_range(n));
+        }
+
+        cout << phase << " " << n;
+        measure_finds<Tree>(perm, queries);
+    }
+}
+
+template<typename Tree>
+void test_phases()
+{
+    print_header("phase n");
+    test_phases_p<Tree>(1000);
+    test_phases_p<Tree>(10000);
+    test_phases_p<Tree>(100000);
+}
+
+// Bytes of heap memory in use, or 0 if we cannot tell.
+size_t heap_in_use()
 {
-    test_subset_s(10);
-    test_subset_s(100);
-    test_subset_s(1000);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    // Older glibc has only mallinfo with int fields, which wrap at 2 GiB.
+    struct mallinfo info = mallinfo();
+    return (unsigned) info.uordblks + (unsigned) info.hblkhd;
+#else
+    return 0;
+#endif
 }
 
-vector<pair<string, function<void()>>> tests = {
-    { "sequential", test_sequential },
-    { "random",     test_random },
-    { "subset",     test_subset },
+// Insert n elements in random order and then find 5n random elements.
+// Print the set size, heap bytes per element and nanoseconds per find.
+template<typename Tree>
+void test_memory()
+{
+    print_header("n bytes_per_key");
+    for (int e=32; e<=80; e+=4) {
+        int n = (int) pow(2, e/4.);
+        vector<int> perm = random_permutation(n);
+        vector<int> queries;
+        for (int i=0; i<5*n; i++)
+            queries.push_back(rng->next_range(n));
+
+        auto build = [&](Tree &tree) {
+            for (int x : perm)
+                tree.insert(x);
+        };
+
+        double bytes_per_key;
+        {
+            size_t before = heap_in_use();
+            Tree tree;
+            build(tree);
+            bytes_per_key = (double) (heap_in_use() - before) / n;
+        }
+
+        cout << n << " " << bytes_per_key;
+        measure<Tree>(build, [&](Tree &tree) {
+            for (int x : queries)
+                tree.lookup(x);
+            return (long) queries.size();
+        });
+    }
+}
+
+/*
+ *  Replaying access traces.
+ *
+ *  A trace is a sequence of (op, key) records, where op is 'i' for insert,
+ *  'l' for lookup and 'r' for remove. It is either a text file with one record
+ *  per line (e.g., "l 42"; lines starting with '#' are ignored), or a binary
+ *  file consisting of TRACE_MAGIC followed by TraceRecords in native byte order.
+ *
+ *  The trace is read from standard input, which must be redirected from a file,
+ *  because we map it to memory instead of reading it all at once.
+ *  We replay it once on an initially empty tree and print one line per
+ *  TRACE_WINDOW operations, so that changes in the workload can be seen.
+ *  Each line starts with first_record, the index of the first trace record
+ *  in its window.
+ */
+
+const char TRACE_MAGIC[8] = { 'S', 'P', 'L', 'A', 'Y', 'T', 'R', '1' };
+
+struct TraceRecord {
+    uint32_t op;
+    int32_t key;
 };
 
+constexpr long TRACE_WINDOW = 100000;
+
+[[noreturn]] void trace_error(const string& msg)
+{
+    cerr << "Trace: " << msg << endl;
+    exit(1);
+}
+
+class TraceReader {
+    const char *data;
+    size_t size;
+    const char *pos, *end;
+    bool binary;
+
+public:
+    TraceReader(int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+            trace_error("standard input must be redirected from a file");
+        size = st.st_size;
+        if (!size)
+            trace_error("empty file");
+
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            trace_error("cannot map file");
+        madvise(map, size, MADV_SEQUENTIAL);
+
+        data = (const char *) map;
+        end = data + size;
+        binary = size >= sizeof(TRACE_MAGIC) && !memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        pos = binary ? data + sizeof(TRACE_MAGIC) : data;
+        if (binary && (end - pos) % sizeof(TraceRecord))
+            trace_error("binary trace ends with a partial record");
+    }
+
+    ~TraceReader()
+    {
+        munmap((void *) data, size);
+    }
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // Read the next record. Returns false at the end of the trace.
+    bool next(char &op, int &key)
+    {
+        if (binary) {
+            if (pos == end)
+                return false;
+            TraceRecord rec;
+            memcpy(&rec, pos, sizeof(rec));
+            pos += sizeof(rec);
+            op = rec.op < 128 ? rec.op : '?';
+            key = rec.key;
+            return true;
+        }
+
+        // Skip white space and comments
+        while (pos < end && (isspace((unsigned char) *pos) || *pos == '#')) {
+            if (*pos == '#')
+                while (pos < end && *pos != '\n')
+                    pos++;
+            else
+                pos++;
+        }
+        if (pos == end)
+            return false;
+
+        op = *pos++;
+        while (pos < end && (*pos == ' ' || *pos == '\t'))
+            pos++;
+        bool negative = pos < end && *pos == '-';
+        if (negative)
+            pos++;
+        if (pos == end || !isdigit((unsigned char) *pos))
+            trace_error("expected a key at offset " + to_string(pos - data));
+        long long value = 0;
+        while (pos < end && isdigit((unsigned char) *pos) && value <= INT32_MAX)
+            value = 10*value + (*pos++ - '0');
+        if (value > INT32_MAX)
+            trace_error("key out of range at offset " + to_string(pos - data));
+        key = negative ? -value : value;
+        return true;
+    }
+};
+
+template<typename Tree>
+void test_trace()
+{
+    TraceReader trace(0);
+    Tree tree;
+    long done = 0;
+    bool more = true;
+
+    print_header("first_record");
+    while (more) {
+        long ops = 0;
+        char op;
+        int key;
+
+        tree.reset();
+        if (perf) {
+            perf->reset();
+            perf->start();
+        }
+        auto start = Clock::now();
+        while (ops < TRACE_WINDOW && (more = trace.next(op, key))) {
+            switch (op) {
+                case 'i':
+                    tree.insert(key);
+                    break;
+                case 'l':
+                    tree.lookup(key);
+                    break;
+                case 'r':
+                    tree.remove(key);
+                    break;
+                default:
+                    trace_error(string("unknown operation '") + op + "' after " + to_string(done + ops) + " records");
+            }
+            ops++;
+        }
+        chrono::duration<double, nano> elapsed = Clock::now() - start;
+        if (perf)
+            perf->stop();
+
+        if (ops) {
+            cout << done;
+            print_values(tree.rot_per_op(), elapsed.count() / ops, ops);
+            done += ops;
+        }
+    }
+}
+
+template<typename Tree>
+void test_subset()
+{
+    print_header("sub n");
+    test_subset_s<Tree>(10);
+    test_subset_s<Tree>(100);
+    test_subset_s<Tree>(1000);
+}
+
+// Run the given test on the given kind of tree.
+template<typename Tree>
+int run_test(const string& which_test)
+{
+    vector<pair<string, function<void()>>> tests = {
+        { "sequential", test_sequential<Tree> },
+        { "random",     test_random<Tree> },
+        { "subset",     test_subset<Tree> },
+        { "memory",     test_memory<Tree> },
+        { "zipf",       test_zipf<Tree> },
+        { "sliding",    test_sliding<Tree> },
+        { "phases",     test_phases<Tree> },
+        { "trace",      test_trace<Tree> },
+    };
+
+    for (const auto& test : tests) {
+        if (test.first == which_test)
+          {
+            cout.precision(12);
+            test.second();
+            return 0;
+          }
+    }
+    cerr << "Unknown test " << which_test << endl;
+    return 1;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 4) {
-        cerr << "Usage: " << argv[0] << " <test> <student-id> (std|naive)" << endl;
+    if (argc != 4 && !(argc == 5 && string(argv[4]) == "perf")) {
+        cerr << "Usage: " << argv[0] << " <test> <student-id> (std|naive|topdown|semi|depth|random|compact) [perf]" << endl;
         return 1;
     }
 
+    if (argc == 5) {
+        perf = new PerfCounters;
+        if (!perf->available()) {
+            cerr << "Hardware performance counters are not available, measuring time only" << endl;
+            delete perf;
+            perf = nullptr;
+        }
+    }
+
     string which_test = argv[1];
     string id_str = argv[2];
     string mode = argv[3];
@@ -186,23 +640,22 @@ int main(int argc, char **argv)
     }
 
     if (mode == "std")
-      naive = false;
+      return run_test<BenchmarkingTree<FullSplay>>(which_test);
     else if (mode == "naive")
-      naive = true;
+      return run_test<BenchmarkingTree<NaiveSplay>>(which_test);
+    else if (mode == "topdown")
+      return run_test<TopDownBenchmarkingTree>(which_test);
+    else if (mode == "semi")
+      return run_test<BenchmarkingTree<SemiSplay>>(which_test);
+    else if (mode == "depth")
+      return run_test<BenchmarkingTree<DepthSplay<16>>>(which_test);
+    else if (mode == "random")
+      return run_test<BenchmarkingTree<RandomSplay<50>>>(which_test);
+    else if (mode == "compact")
+      return run_test<CompactBenchmarkingTree>(which_test);
     else
       {
-        cerr << "Last argument must be either 'std' or 'naive'" << endl;
+        cerr << "Last argument must be one of 'std', 'naive', 'topdown', 'semi', 'depth', 'random' or 'compact'" << endl;
         return 1;
       }
-
-    for (const auto& test : tests) {
-        if (test.first == which_test)
-          {
-            cout.precision(12);
-            test.second();
-            return 0;
-          }
-    }
-    cerr << "Unknown test " << which_test << endl;
-    return 1;
 }
@@ -0,0 +1,113 @@
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sharded_tree.h"
+#include "random.h"
+#include "throughput.h"
+
+using namespace std;
+using namespace splay;
+
+/*
+ *  Multi-threaded throughput of shared splay trees.
+ *
+ *  All threads operate on one set of N keys: 95% of operations are lookups
+ *  of random keys, the rest are inserts and removes of random keys.
+ *  For every number of threads up to the number of CPUs, we report
+ *  the total number of operations per second.
+ */
+
+constexpr int N = 1 << 20;
+constexpr double DURATION = .5;     // Seconds per measurement
+
+// The baseline: a single tree serialized behind one mutex.
+class LockedTree {
+    mutex lock;
+    Tree tree;
+
+  public:
+    bool lookup(int key)
+    {
+        lock_guard<mutex> guard(lock);
+        return tree.lookup(key);
+    }
+
+    void insert(int key)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.insert(key);
+    }
+
+    void remove(int key)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.remove(key);
+    }
+};
+
+// A tree sharded by key ranges into 64 equal parts of the key space.
+class RangeShardedTree : public ShardedTree<> {
+    static vector<int> make_bounds()
+    {
+        vector<int> bounds;
+        for (int i=1; i<64; i++)
+            bounds.push_back((int64_t) i * N / 64);
+        return bounds;
+    }
+
+  public:
+    RangeShardedTree() : ShardedTree<>(make_bounds()) {}
+};
+
+int seed;               // Random seed given on the command line
+
+template<typename SharedTree>
+void test_throughput()
+{
+    measure_throughput<SharedTree>(seed, DURATION, [](SharedTree &tree, RandomGen &rng) {
+        for (int i=0; i<N; i++)
+            if (rng.next_range(2))
+                tree.insert(i);
+    }, [](SharedTree &tree, RandomGen &rng) {
+        unsigned what = rng.next_range(40);
+        int key = rng.next_range(N);
+        if (what < 38)
+            tree.lookup(key);
+        else if (what == 38)
+            tree.insert(key);
+        else
+            tree.remove(key);
+    });
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " <student-id> (mutex|sharded)" << endl;
+        return 1;
+    }
+
+    string mode = argv[2];
+
+    try {
+        seed = stoi(argv[1]);
+    } catch (...) {
+        cerr << "Invalid student ID" << endl;
+        return 1;
+    }
+
+    cout.precision(12);
+    if (mode == "mutex")
+        test_throughput<LockedTree>();
+    else if (mode == "sharded")
+        test_throughput<RangeShardedTree>();
+    else {
+        cerr << "Last argument must be either 'mutex' or 'sharded'" << endl;
+        return 1;
+    }
+    return 0;
+}
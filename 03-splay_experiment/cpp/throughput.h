@@ -0,0 +1,62 @@
+#ifndef DS1_THROUGHPUT_H
+#define DS1_THROUGHPUT_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "random.h"
+
+/*
+ *  Multi-threaded throughput of a shared data structure.
+ *
+ *  For every number of threads up to the number of CPUs, a fresh structure
+ *  is filled by `fill(tree, rng)` and then all threads repeatedly call
+ *  `operation(tree, rng)` with their own random generators for `duration`
+ *  seconds. We print the number of threads and the total number
+ *  of operations per second.
+ */
+template<typename SharedTree, typename Fill, typename Operation>
+void measure_throughput(int seed, double duration, Fill fill, Operation operation)
+{
+    unsigned max_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    for (unsigned num_threads=1; num_threads<=max_threads; num_threads++) {
+        SharedTree tree;
+        RandomGen rng(seed);
+        fill(tree, rng);
+
+        std::atomic<bool> stop(false);
+        std::vector<uint64_t> ops(num_threads);
+        std::vector<std::thread> threads;
+        for (unsigned t=0; t<num_threads; t++)
+            threads.emplace_back([&, t] {
+                RandomGen rng(seed + t + 1);
+                uint64_t done = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int i=0; i<256; i++)
+                        operation(tree, rng);
+                    done += 256;
+                }
+                ops[t] = done;
+            });
+
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        stop = true;
+        for (auto& thread : threads)
+            thread.join();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        uint64_t total = 0;
+        for (uint64_t done : ops)
+            total += done;
+        std::cout << num_threads << " " << total / elapsed.count() << std::endl;
+    }
+}
+
+#endif
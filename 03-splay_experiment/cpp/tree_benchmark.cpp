@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// The trees of different assignments live in namespaces successor and splay,
+// the (a,b)-tree uses the ab_ prefix.
+#include "tree_successor.h"
+#include "splay_operation.h"
+#include "ab_tree.h"
+#include "random.h"
+#include "zipf.h"
+
+using namespace std;
+
+void expect_failed(const string& message) {
+    cerr << "ab_tree: " << message << endl;
+    exit(1);
+}
+
+/*
+ *  Adapters giving all the ordered sets the same interface:
+ *
+ *      insert(x)           insert the key x
+ *      find(x)             return true if x is present
+ *      successor(x, y)     set y to the smallest key greater than x,
+ *                          return false if there is none
+ */
+
+class SuccessorSet {
+    successor::Tree tree;
+
+  public:
+    void insert(int x) { tree.insert(x); }
+
+    bool find(int x) { return tree.find(x); }
+
+    bool successor(int x, int &y)
+    {
+        auto it = tree.lower_bound(x);
+        if (it != tree.end() && it->key == x)
+            ++it;
+        if (it == tree.end())
+            return false;
+        y = it->key;
+        return true;
+    }
+};
+
+class SplaySet {
+    splay::Tree tree;
+
+  public:
+    void insert(int x) { tree.insert(x); }
+
+    bool find(int x) { return tree.lookup(x); }
+
+    // After the lookup, the root is either x or one of its neighbors.
+    bool successor(int x, int &y)
+    {
+        tree.lookup(x);
+        splay::Node *n = tree.root;
+        if (!n)
+            return false;
+        if (n->key <= x) {
+            if (!(n = n->right))
+                return false;
+            while (n->left)
+                n = n->left;
+        }
+        y = n->key;
+        return true;
+    }
+};
+
+class ABSet {
+    static constexpr int A = 8, B = 16;     // Node degrees
+    ab_tree tree{A, B};
+
+  public:
+    void insert(int x) { tree.insert(x); }
+
+    bool find(int x) { return tree.find(x); }
+
+    bool successor(int x, int &y)
+    {
+        bool found = false;
+        for (ab_node *n = tree.root; n; ) {
+            size_t i = upper_bound(n->keys.begin(), n->keys.end(), x) - n->keys.begin();
+            if (i < n->keys.size()) {
+                y = n->keys[i];
+                found = true;
+            }
+            n = n->children[i];
+        }
+        return found;
+    }
+};
+
+class StdSet {
+    set<int> tree;
+
+  public:
+    void insert(int x) { tree.insert(x); }
+
+    bool find(int x) { return tree.count(x); }
+
+    bool successor(int x, int &y)
+    {
+        auto it = tree.upper_bound(x);
+        if (it == tree.end())
+            return false;
+        y = *it;
+        return true;
+    }
+};
+
+RandomGen *rng;         // Random generator object
+volatile long sink;     // Results of queries go here, so that they cannot be optimized out
+
+typedef chrono::steady_clock Clock;
+constexpr double MIN_TIME = .1;     // Minimum measured time per data point in seconds
+
+// An auxiliary function for generating a random permutation.
+vector<int> random_permutation(int n)
+{
+    vector<int> perm;
+    for (int i=0; i<n; i++)
+        perm.push_back(i);
+    for (int i=0; i<n-1; i++)
+        swap(perm[i], perm[i + rng->next_range(n-i)]);
+    return perm;
+}
+
+// Bytes of heap memory in use, or 0 if we cannot tell.
+size_t heap_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    // Older glibc has only mallinfo with int fields, which wrap at 2 GiB.
+    struct mallinfo info = mallinfo();
+    return (unsigned) info.uordblks + (unsigned) info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+// Peak resident set size of the process in KiB.
+long max_rss_kib()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/*
+ *  Insert the keys, then find all queries and then ask for successors
+ *  of all queries. This is repeated on fresh sets until it takes at least
+ *  MIN_TIME in total. We print the set size, nanoseconds per operation
+ *  of each kind, heap bytes per key and peak RSS of the whole process.
+ */
+template<typename Set>
+void measure(const vector<int> &keys, const vector<int> &queries)
+{
+    chrono::duration<double, nano> t_insert(0), t_find(0), t_succ(0);
+    double bytes_per_key = -1;
+    long checksum = 0, trials = 0;
+
+    do {
+        size_t before = heap_in_use();
+        Set s;
+
+        auto start = Clock::now();
+        for (int x : keys)
+            s.insert(x);
+        auto inserted = Clock::now();
+        for (int x : queries)
+            checksum += s.find(x);
+        auto found = Clock::now();
+        for (int x : queries) {
+            int y;
+            if (s.successor(x, y))
+                checksum += y;
+        }
+        auto done = Clock::now();
+
+        t_insert += inserted - start;
+        t_find += found - inserted;
+        t_succ += done - found;
+        if (bytes_per_key < 0)
+            bytes_per_key = (double) (heap_in_use() - before) / keys.size();
+        trials++;
+    } while ((t_insert + t_find + t_succ).count() < MIN_TIME * 1e9);
+
+    cout << keys.size()
+         << " " << t_insert.count() / (trials * keys.size())
+         << " " << t_find.count() / (trials * queries.size())
+         << " " << t_succ.count() / (trials * queries.size())
+         << " " << bytes_per_key
+         << " " << max_rss_kib() << endl;
+    sink = checksum;
+}
+
+// Insert keys 0..n-1 in increasing order, query them in increasing order.
+// The tree from tree_successor is not balanced, so we stay with small n.
+template<typename Set>
+void test_sequential(int n)
+{
+    vector<int> keys;
+    for (int i=0; i<n; i++)
+        keys.push_back(i);
+    measure<Set>(keys, keys);
+}
+
+// Insert keys 0..n-1 in random order, query n random keys.
+template<typename Set>
+void test_random(int n)
+{
+    vector<int> keys = random_permutation(n);
+    vector<int> queries;
+    for (int i=0; i<n; i++)
+        queries.push_back(rng->next_range(n));
+    measure<Set>(keys, queries);
+}
+
+// Insert keys 0..n-1 in random order, query n keys with Zipf distribution (s=1)
+// over randomly chosen ranks of popularity.
+template<typename Set>
+void test_skewed(int n)
+{
+    vector<int> keys = random_permutation(n);
+    vector<int> popular = random_permutation(n);
+    ZipfGen zipf(*rng, n, 1);
+    vector<int> queries;
+    for (int i=0; i<n; i++)
+        queries.push_back(popular[zipf.next()]);
+    measure<Set>(keys, queries);
+}
+
+// Run the given workload on the given kind of set for all set sizes.
+template<typename Set>
+int run_test(const string& which_test)
+{
+    struct test {
+        string name;
+        function<void(int)> run;
+        int max_e;      // Set sizes are 2^(e/4) for e up to max_e
+    };
+    vector<test> tests = {
+        { "sequential", test_sequential<Set>, 56 },
+        { "random",     test_random<Set>,     80 },
+        { "skewed",     test_skewed<Set>,     80 },
+    };
+
+    for (const auto& test : tests) {
+        if (test.name == which_test)
+          {
+            cout.precision(12);
+            cout << "# n insert_ns find_ns successor_ns bytes_per_key max_rss_kib" << endl;
+            for (int e=32; e<=test.max_e; e+=4)
+                test.run((int) pow(2, e/4.));
+            return 0;
+          }
+    }
+    cerr << "Unknown test " << which_test << endl;
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        cerr << "Usage: " << argv[0] << " <test> <student-id> (successor|splay|ab|set)" << endl;
+        return 1;
+    }
+
+    string which_test = argv[1];
+    string id_str = argv[2];
+    string mode = argv[3];
+
+    try {
+        rng = new RandomGen(stoi(id_str));
+    } catch (...) {
+        cerr << "Invalid student ID" << endl;
+        return 1;
+    }
+
+    if (mode == "successor")
+      return run_test<SuccessorSet>(which_test);
+    else if (mode == "splay")
+      return run_test<SplaySet>(which_test);
+    else if (mode == "ab")
+      return run_test<ABSet>(which_test);
+    else if (mode == "set")
+      return run_test<StdSet>(which_test);
+    else
+      {
+        cerr << "Last argument must be one of 'successor', 'splay', 'ab' or 'set'" << endl;
+        return 1;
+      }
+}
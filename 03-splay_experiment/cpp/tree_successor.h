@@ -0,0 +1 @@
+../../01-tree_successor/cpp/tree_successor.h
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef DS1_ZIPF_H
+#define DS1_ZIPF_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "random.h"
+
+// Generator of ranks 0..n-1 with Zipf distribution: Pr[i] is proportional to 1/(i+1)^s.
+class ZipfGen {
+    RandomGen &rng;
+    std::vector<double> cdf;
+
+    // A uniformly distributed real number in [0,1).
+    double random_unit()
+    {
+        return (rng.next_u64() >> 11) * 0x1.0p-53;
+    }
+
+  public:
+    ZipfGen(RandomGen &rng, int n, double s) : rng(rng)
+    {
+        double sum = 0;
+        for (int i=0; i<n; i++) {
+            sum += std::pow(i+1, -s);
+            cdf.push_back(sum);
+        }
+        for (double &x : cdf)
+            x /= sum;
+    }
+
+    int next()
+    {
+        int i = std::upper_bound(cdf.begin(), cdf.end(), random_unit()) - cdf.begin();
+        return std::min(i, (int) cdf.size() - 1);
+    }
+};
+
+#endif
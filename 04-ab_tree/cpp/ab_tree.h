@@ -1,7 +1,15 @@
+#ifndef DS1_AB_TREE_H
+#define DS1_AB_TREE_H
+
+#include <algorithm>
+#include <iterator>
 #include <limits>
-#include <stack>
+#include <utility>
 #include <vector>
 #include <iostream>
+#if defined(__SSE2__) && !defined(AB_TREE_NO_SIMD)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -10,53 +18,207 @@ using namespace std;
 
 void expect_failed(const string& message);
 
+/*** Searching in sorted keys ***/
+
+// Return the number of keys less than the given one in a sorted array
+// by scanning it sequentially.
+inline std::size_t ab_rank_scalar(const int *keys, std::size_t n, int key)
+{
+    std::size_t i = 0;
+    while (i < n && keys[i] < key)
+        i++;
+    return i;
+}
+
+// The same, comparing the key with 8 (AVX2) or 4 (SSE2) keys at once and
+// counting the smaller ones in the comparison mask. As the keys are sorted,
+// we can stop at the first block where not all keys are smaller.
+// Define AB_TREE_NO_SIMD to use the scalar version everywhere.
+inline std::size_t ab_rank(const int *keys, std::size_t n, int key)
+{
+    std::size_t i = 0;
+#if defined(__AVX2__) && !defined(AB_TREE_NO_SIMD)
+    const __m256i k = _mm256_set1_epi32(key);
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (keys + i));
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+        if (mask != 0xff)
+            return i + __builtin_popcount(mask);
+    }
+#elif defined(__SSE2__) && !defined(AB_TREE_NO_SIMD)
+    const __m128i k = _mm_set1_epi32(key);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (keys + i));
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k)));
+        if (mask != 0xf)
+            return i + __builtin_popcount(mask);
+    }
+#endif
+    return i + ab_rank_scalar(keys + i, n - i, key);
+}
+
+// Ask the CPU to start loading the given address into the cache.
+inline void ab_prefetch(const void *address)
+{
+#ifdef __GNUC__
+    __builtin_prefetch(address);
+#else
+    (void) address;
+#endif
+}
+
+/*** Fixed-capacity array ***/
+
+// A replacement for vector<T> with capacity N, whose elements live inline
+// in the object. It supports just the operations needed by the nodes.
+template<typename T, std::size_t N>
+class fixed_vector {
+    T items[N];
+    std::size_t count = 0;
+
+  public:
+    typedef T value_type;
+    typedef T *iterator;
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // The capacity is fixed, so we only check that it suffices.
+    void reserve(std::size_t n) { EXPECT(n <= N, "Capacity of fixed_vector exceeded"); }
+
+    T *data() { return items; }
+    T &operator[](std::size_t i) { return items[i]; }
+    const T &operator[](std::size_t i) const { return items[i]; }
+    T &front() { return items[0]; }
+    T &back() { return items[count-1]; }
+
+    iterator begin() { return items; }
+    iterator end() { return items + count; }
+
+    void push_back(const T &x) { items[count++] = x; }
+    void emplace_back(const T &x) { items[count++] = x; }
+    void pop_back() { count--; }
+
+    iterator insert(iterator pos, const T &x)
+    {
+        std::move_backward(pos, end(), end() + 1);
+        *pos = x;
+        count++;
+        return pos;
+    }
+
+    iterator erase(iterator first, iterator last)
+    {
+        std::move(last, end(), first);
+        count -= last - first;
+        return first;
+    }
+
+    iterator erase(iterator pos) { return erase(pos, pos + 1); }
+
+    template<typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        count = std::copy(first, last, items) - items;
+    }
+
+    // Only shrinking is supported.
+    void resize(std::size_t n) { count = n; }
+};
+
+/*** Path from the root ***/
+
+// A stack of (node, index of child) pairs on the path from the root,
+// where nodes are referred to by values of type Ref (pointers or page numbers).
+// It lives in a fixed array, so walking down the tree never allocates memory.
+template<typename Ref>
+class ab_path {
+    // Even with a=2, a tree with less than 2^32 keys has at most 32 levels.
+    static constexpr int MAX_HEIGHT = 33;
+    std::pair<Ref, std::size_t> items[MAX_HEIGHT];
+    int depth = 0;
+
+  public:
+    void emplace(Ref n, std::size_t i)
+    {
+        EXPECT(depth < MAX_HEIGHT, "Tree too high");
+        items[depth++] = { n, i };
+    }
+
+    const std::pair<Ref, std::size_t> &top() const { return items[depth-1]; }
+    void pop() { depth--; }
+};
+
 /*** One node ***/
 
-class ab_node {
+// The node of type Self stores its keys and children in containers
+// of types Keys and Children, which behave like vectors.
+template<typename Self, typename Keys, typename Children>
+class basic_ab_node {
   public:
     // Keys stored in this node and the corresponding children
-    // The vectors are large enough to accomodate one extra entry
+    // The containers are large enough to accomodate one extra entry
     // in overflowing nodes.
-    vector<ab_node *> children;
-    vector<int> keys;
+    Children children;
+    Keys keys;
 
     // If this node contains the given key, return true and set i to key's position.
     // Otherwise return false and set i to the first key greater than the given one.
     bool find_branch(int key, std::size_t &i)
     {
-        i = 0;
-        while (i < keys.size() && keys[i] <= key) {
-            if (keys[i] == key)
-                return true;
-            i++;
-        }
-        return false;
+        i = ab_rank(keys.data(), keys.size(), key);
+        return i < keys.size() && keys[i] == key;
     }
 
     // Insert a new key at posision i and add a new child between keys i and i+1.
-    void insert_branch(std::size_t i, int key, ab_node *child)
+    void insert_branch(std::size_t i, int key, Self *child)
     {
         keys.insert(keys.begin() + i, key);
         children.insert(children.begin() + i + 1, child);
     }
 
+    // Start loading all keys of this node into the cache.
+    void prefetch_keys()
+    {
+        const char *first = (const char *) keys.data();
+        const char *last = (const char *) (keys.data() + keys.size());
+        for (const char *p = first; p < last; p += 64)
+            ab_prefetch(p);
+    }
+
     // An auxiliary function for displaying a sub-tree under this node.
     void show(int indent);
 };
 
+// A node with keys and children in separately allocated vectors, so b can be arbitrary.
+class ab_node : public basic_ab_node<ab_node, vector<int>, vector<ab_node *>> {
+  public:
+    static constexpr int max_b = numeric_limits<int>::max();
+};
+
+// A node with keys and children stored inline, which allows b up to B.
+// It is a single allocation and its keys are at a fixed offset.
+template<int B>
+class inline_ab_node : public basic_ab_node<inline_ab_node<B>, fixed_vector<int, B>, fixed_vector<inline_ab_node<B> *, B+1>> {
+  public:
+    static constexpr int max_b = B;
+};
+
 /*** Tree ***/
 
-class ab_tree {
+// The (a,b)-tree built of nodes of type Node, which must allow the given b.
+template<typename Node>
+class basic_ab_tree {
   public:
     int a;          // Minimum allowed number of children
     int b;          // Maximum allowed number of children
-    ab_node *root;  // Root node (even a tree with no keys has a root)
+    Node *root;     // Root node (even a tree with no keys has a root)
     int num_nodes;  // We keep track of how many nodes the tree has
 
     // Create a new node and return a pointer to it.
-    ab_node *new_node()
+    Node *new_node()
     {
-        ab_node *n = new ab_node;
+        Node *n = new Node;
         n->keys.reserve(b);
         n->children.reserve(b+1);
         num_nodes++;
@@ -64,16 +226,17 @@ class ab_tree {
     }
 
     // Delete a given node, assuming that its children have been already unlinked.
-    void delete_node(ab_node *n)
+    void delete_node(Node *n)
     {
         num_nodes--;
         delete n;
     }
 
     // Constructor: initialize an empty tree with just the root.
-    ab_tree(int a, int b)
+    basic_ab_tree(int a, int b)
     {
         EXPECT(a >= 2 && b >= 2*a - 1, "Invalid values of a,b");
+        EXPECT(b <= Node::max_b, "Value of b too large for the node type");
         this->a = a;
         this->b = b;
         num_nodes = 0;
@@ -83,7 +246,7 @@ class ab_tree {
     }
 
     // An auxiliary function for deleting a subtree recursively.
-    void delete_tree(ab_node *n)
+    void delete_tree(Node *n)
     {
         for (int i=0; i < n->children.size(); i++)
             if (n->children[i])
@@ -92,7 +255,7 @@ class ab_tree {
     }
 
     // Destructor: delete all nodes.
-    ~ab_tree()
+    ~basic_ab_tree()
     {
         delete_tree(root);
         EXPECT(num_nodes == 0, "Memory leak detected: some nodes were not deleted");
@@ -101,7 +264,7 @@ class ab_tree {
     // Find a key: returns true if it is present in the tree.
     bool find(int key) const
     {
-        ab_node *n = root;
+        Node *n = root;
         while (n) {
             std::size_t i;
             if (n->find_branch(key, i))
@@ -111,6 +274,62 @@ class ab_tree {
         return false;
     }
 
+    // Number of keys which find_batch() looks up together.
+    static constexpr std::size_t FIND_BATCH = 16;
+
+    // Find many keys: set results[j] to true if keys[j] is present in the tree.
+    //
+    // Keys are processed in groups of FIND_BATCH, which descend in lockstep:
+    // at every level, we first start loading the nodes of all keys in the group
+    // and only then search in them, so the cache misses overlap instead of
+    // being waited for one by one. All leaves are at the same depth,
+    // so the keys of one group stay on the same level.
+    //
+    // The results vector is reallocated only if it is too small. Callers
+    // which care about latency should reuse it: a large allocation can make
+    // malloc consolidate all small chunks freed before, which may take longer
+    // than the lookups themselves.
+    void find_batch(const std::vector<int> &keys, std::vector<bool> &results) const
+    {
+        results.assign(keys.size(), false);
+
+        for (std::size_t start = 0; start < keys.size(); start += FIND_BATCH) {
+            const std::size_t count = std::min(FIND_BATCH, keys.size() - start);
+            Node *nodes[FIND_BATCH];
+            std::size_t active = count;
+            for (std::size_t j = 0; j < count; j++)
+                nodes[j] = root;
+
+            while (active) {
+                // nodes were prefetched on the previous level, now their keys
+
+                for (std::size_t j = 0; j < count; j++)
+                    if (nodes[j])
+                        nodes[j]->prefetch_keys();
+
+                for (std::size_t j = 0; j < count; j++) {
+                    Node *n = nodes[j];
+                    if (!n)
+                        continue;
+
+                    std::size_t i;
+                    if (n->find_branch(keys[start + j], i)) {
+                        results[start + j] = true;
+                        n = nullptr;
+                    } else {
+                        n = n->children[i];
+                    }
+
+                    if (n)
+                        ab_prefetch(n);
+                    else
+                        active--;
+                    nodes[j] = n;
+                }
+            }
+        }
+    }
+
     // Display the tree on standard output in human-readable form.
     void show();
 
@@ -120,11 +339,11 @@ class ab_tree {
     // Insert: add key to the tree (unless it was already present).
     void insert(int key)
     {
-        ab_node *n = root;
+        Node *n = root;
         std::size_t i;
 
         // holds the path to the inserted key
-        std::stack<std::pair<ab_node * const, std::size_t>> parents;
+        ab_path<Node *> parents;
 
         do {
             if (n->find_branch(key, i))
@@ -138,17 +357,16 @@ class ab_tree {
         while (n->keys.size() >= b) {
             // splitting n into n and m
 
-            ab_node * const m = new_node();
+            Node * const m = new_node();
             i = n->keys.size() / 2 + 1;
             key = n->keys[i - 1];
 
-            std::move(n->keys.begin() + i, n->keys.end(),
-                std::back_inserter(m->keys));
-            std::move(n->children.begin() + i, n->children.end(),
-                std::back_inserter(m->children));
+            // both nodes have enough capacity, so this just copies memory
+            m->keys.assign(n->keys.begin() + i, n->keys.end());
+            m->children.assign(n->children.begin() + i, n->children.end());
 
-            n->keys.erase(n->keys.begin() + (i - 1), n->keys.end());
-            n->children.erase(n->children.begin() + i, n->children.end());
+            n->keys.resize(i - 1);
+            n->children.resize(i);
 
             if (n == root) {
                 // we need a new layer
@@ -170,4 +388,228 @@ class ab_tree {
             }
         }
     }
+
+    // Remove: delete key from the tree. Returns false if it was not present.
+    bool remove(int key)
+    {
+        Node *n = root;
+        std::size_t i;
+
+        // holds the path to n, with the index of the child taken in each node
+        ab_path<Node *> parents;
+
+        while (!n->find_branch(key, i)) {
+            if (n->children[i] == nullptr)
+                return false;
+
+            parents.emplace(n, i);
+            n = n->children[i];
+        }
+
+        if (n->children[i] != nullptr) {
+            // the key is in an internal node, so we replace it by its
+            // predecessor, which is the largest key in a leaf below
+
+            parents.emplace(n, i);
+            Node *leaf = n->children[i];
+            while (leaf->children.back() != nullptr) {
+                parents.emplace(leaf, leaf->children.size() - 1);
+                leaf = leaf->children.back();
+            }
+
+            n->keys[i] = leaf->keys.back();
+            n = leaf;
+            i = n->keys.size() - 1;
+        }
+
+        // all children of a leaf are null, so we can drop any of them
+        n->keys.erase(n->keys.begin() + i);
+        n->children.pop_back();
+
+        while (n != root && n->children.size() < a) {
+            // n has too few children: borrow one from a sibling, or merge with it
+
+            const auto [parent, j] = parents.top();
+            parents.pop();
+
+            Node * const left = j > 0 ? parent->children[j - 1] : nullptr;
+            Node * const right = j + 1 < parent->children.size() ? parent->children[j + 1] : nullptr;
+
+            if (left && left->children.size() > a) {
+                // rotate the last child of the left sibling through the parent
+
+                n->keys.insert(n->keys.begin(), parent->keys[j - 1]);
+                n->children.insert(n->children.begin(), left->children.back());
+                parent->keys[j - 1] = left->keys.back();
+
+                left->keys.pop_back();
+                left->children.pop_back();
+
+                break;
+            } else if (right && right->children.size() > a) {
+                // rotate the first child of the right sibling through the parent
+
+                n->insert_branch(n->keys.size(), parent->keys[j], right->children.front());
+                parent->keys[j] = right->keys.front();
+
+                right->keys.erase(right->keys.begin());
+                right->children.erase(right->children.begin());
+
+                break;
+            } else {
+                // both siblings are minimal, so merging n with one of them
+                // gives at most 2a-1 <= b children
+
+                const std::size_t k = left ? j - 1 : j;
+                Node * const l = parent->children[k];
+                Node * const r = parent->children[k + 1];
+
+                l->keys.push_back(parent->keys[k]);
+                std::move(r->keys.begin(), r->keys.end(),
+                    std::back_inserter(l->keys));
+                std::move(r->children.begin(), r->children.end(),
+                    std::back_inserter(l->children));
+
+                parent->keys.erase(parent->keys.begin() + k);
+                parent->children.erase(parent->children.begin() + k + 1);
+                delete_node(r);
+
+                n = parent;
+            }
+        }
+
+        if (root->keys.empty() && root->children.front() != nullptr) {
+            // the root lost its last key, so we drop a layer
+
+            Node * const old_root = root;
+            root = root->children.front();
+            delete_node(old_root);
+        }
+
+        return true;
+    }
+
+    // Bulk load: replace the contents of the tree by keys from a sorted range.
+    //
+    // The tree is built bottom-up in linear time, one level at a time.
+    // Nodes get about fill_factor * b children (but at least a), so a lower
+    // fill factor leaves room for later inserts without splitting.
+    // Keys which are not greater than their predecessor in the range are skipped.
+    // The range is traversed once and its keys go directly to the leaves,
+    // so apart from the tree, only the level being built is kept in memory.
+    template<typename Iterator>
+    void bulk_load(Iterator begin, Iterator end, double fill_factor = 1.0)
+    {
+        delete_tree(root);
+
+        const std::size_t c = std::clamp((int) (fill_factor * b + 0.5), a, b);
+
+        // nodes of the level being built and the keys between them
+        std::vector<int> keys;
+        std::vector<Node *> children;
+
+        // fill leaves with c children each, the key after a full leaf goes up
+        Node *leaf = new_node();
+        leaf->children.push_back(nullptr);
+        bool empty = true;
+        int last = 0;
+        for (; begin != end; ++begin) {
+            const int key = *begin;
+            if (!empty && !(last < key))
+                continue;
+            empty = false;
+            last = key;
+
+            if (leaf->children.size() < c) {
+                leaf->keys.push_back(key);
+                leaf->children.push_back(nullptr);
+            } else {
+                children.push_back(leaf);
+                keys.push_back(key);
+                leaf = new_node();
+                leaf->children.push_back(nullptr);
+            }
+        }
+        children.push_back(leaf);
+
+        if (children.size() > 1 && leaf->children.size() < a) {
+            // the last leaf is too small, so we redistribute the keys
+            // of the last two leaves, merging them if they fit in one
+
+            Node * const prev = children[children.size() - 2];
+            std::vector<int> merged(prev->keys.begin(), prev->keys.end());
+            merged.push_back(keys.back());
+            merged.insert(merged.end(), leaf->keys.begin(), leaf->keys.end());
+            keys.pop_back();
+            children.pop_back();
+
+            auto fill_leaf = [](Node *n, const int *from, const int *to) {
+                n->keys.assign(from, to);
+                n->children.resize(0);
+                for (std::size_t q = 0; q <= n->keys.size(); q++)
+                    n->children.push_back(nullptr);
+            };
+
+            if (merged.size() < b) {
+                fill_leaf(prev, merged.data(), merged.data() + merged.size());
+                delete_node(leaf);
+            } else {
+                const std::size_t h = merged.size() / 2;
+                fill_leaf(prev, merged.data(), merged.data() + h);
+                keys.push_back(merged[h]);
+                fill_leaf(leaf, merged.data() + h + 1, merged.data() + merged.size());
+                children.push_back(leaf);
+            }
+        }
+
+        if (children.size() == 1) {
+            root = children.front();
+            return;
+        }
+
+        while (children.size() > b) {
+            // split t children into m nodes with t/m children each (rounded
+            // up or down), which must be between a and b
+
+            const std::size_t t = children.size();
+            const std::size_t m = std::clamp((t + c - 1) / c, (t + b - 1) / b, t / a);
+
+            std::vector<int> up_keys;
+            std::vector<Node *> up_children;
+            up_keys.reserve(m - 1);
+            up_children.reserve(m);
+
+            std::size_t pos = 0;
+            for (std::size_t j = 0; j < m; j++) {
+                const std::size_t size = t / m + (j < t % m);
+
+                Node * const n = new_node();
+                for (std::size_t q = 0; q < size; q++) {
+                    n->children.push_back(children[pos + q]);
+                    if (q + 1 < size)
+                        n->keys.push_back(keys[pos + q]);
+                }
+                pos += size;
+
+                // the key between this node and the next one goes up
+                if (j + 1 < m)
+                    up_keys.push_back(keys[pos - 1]);
+                up_children.push_back(n);
+            }
+
+            keys.swap(up_keys);
+            children.swap(up_children);
+        }
+
+        root = new_node();
+        for (std::size_t q = 0; q < children.size(); q++) {
+            root->children.push_back(children[q]);
+            if (q < keys.size())
+                root->keys.push_back(keys[q]);
+        }
+    }
 };
+
+typedef basic_ab_tree<ab_node> ab_tree;
+
+#endif
@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "ab_tree.h"
+#include "bplus_tree.h"
+#include "paged_ab_tree.h"
+#include "random.h"
+
+RandomGen *rng;         // Random generator object
+volatile long sink;     // Results of queries go here, so that they cannot be optimized out
+
+typedef chrono::steady_clock Clock;
+constexpr double MIN_TIME = .1;     // Minimum measured time per data point in seconds
+
+void expect_failed(const string& message) {
+    cerr << "Error: " << message << endl;
+    exit(1);
+}
+
+// We count all memory allocations by replacing the global operator new.
+// Our operator delete is not inlined, because GCC would then wrongly warn
+// that memory from operator new is released by free().
+long num_allocations;
+
+void *operator new(std::size_t size)
+{
+    num_allocations++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// The (a,b) pairs on which all tests are run.
+const vector<pair<int, int>> degrees = {
+    { 2, 3 }, { 2, 4 }, { 8, 16 }, { 32, 64 }, { 128, 256 },
+};
+
+/*
+ *  A set of n random keys from [0, 4n), which changes by replacing
+ *  a random key by a new random key not in the set.
+ */
+class ChurningSet {
+    vector<int> keys;
+    vector<bool> present;
+
+    int absent_key()
+    {
+        int key;
+        do
+            key = rng->next_range(present.size());
+        while (present[key]);
+        return key;
+    }
+
+  public:
+    ChurningSet(int n) : present(4*n)
+    {
+        while (keys.size() < n) {
+            int key = absent_key();
+            present[key] = true;
+            keys.push_back(key);
+        }
+    }
+
+    const vector<int> &get_keys() { return keys; }
+
+    // Replace a random key, return the old and the new one.
+    pair<int, int> replace()
+    {
+        int &key = keys[rng->next_range(keys.size())];
+        int old_key = key;
+        key = absent_key();
+        present[old_key] = false;
+        present[key] = true;
+        return { old_key, key };
+    }
+};
+
+/*
+ *  Churn test: we build a tree with n random keys and then repeatedly remove
+ *  a random key and insert a new one, so the size stays the same. We print
+ *  a, b, n, nanoseconds per operation (an insert or a remove) and the number
+ *  of nodes per key at the end.
+ */
+template<typename Tree>
+void churn(int a, int b)
+{
+    for (int e=40; e<=80; e+=4) {
+        int n = (int) pow(2, e/4.);
+        ChurningSet set(n);
+        Tree tree(a, b);
+        for (int key : set.get_keys())
+            tree.insert(key);
+
+        // Changes are generated in rounds of n, only the tree operations are timed.
+        vector<pair<int, int>> changes(n);
+        long ops = 0;
+        chrono::duration<double, nano> elapsed(0);
+        do {
+            for (auto &change : changes)
+                change = set.replace();
+
+            auto start = Clock::now();
+            for (auto [old_key, new_key] : changes) {
+                tree.remove(old_key);
+                tree.insert(new_key);
+            }
+            elapsed += Clock::now() - start;
+            ops += 2*n;
+        } while (elapsed.count() < MIN_TIME * 1e9);
+
+        for (int key : set.get_keys())
+            EXPECT(tree.find(key), "Key lost during churn");
+
+        cout << a << " " << b << " " << n << " " << elapsed.count() / ops
+             << " " << (double) tree.num_nodes / n << endl;
+    }
+}
+
+void test_churn()
+{
+    cout << "# a b n ns_per_op nodes_per_key" << endl;
+    for (auto [a, b] : degrees)
+        churn<ab_tree>(a, b);
+}
+
+// The same with nodes of fixed capacity b
+void test_churn_inline()
+{
+    cout << "# a b n ns_per_op nodes_per_key" << endl;
+    churn<basic_ab_tree<inline_ab_node<3>>>(2, 3);
+    churn<basic_ab_tree<inline_ab_node<4>>>(2, 4);
+    churn<basic_ab_tree<inline_ab_node<16>>>(8, 16);
+    churn<basic_ab_tree<inline_ab_node<64>>>(32, 64);
+    churn<basic_ab_tree<inline_ab_node<256>>>(128, 256);
+}
+
+/*
+ *  Find test: a tree with n random keys, in which we search for random keys
+ *  (about 1/4 of them present). For each b, we print a=b/2, b, n and
+ *  nanoseconds per find for nodes with keys in vectors and in inline arrays.
+ *  Compile with -DAB_TREE_NO_SIMD to compare with the scalar search in nodes.
+ */
+template<typename Tree>
+double ns_per_find(int a, int b, const vector<int> &keys, const vector<int> &queries)
+{
+    Tree tree(a, b);
+    for (int key : keys)
+        tree.insert(key);
+
+    long found = 0, ops = 0;
+    chrono::duration<double, nano> elapsed(0);
+    do {
+        auto start = Clock::now();
+        for (int key : queries)
+            found += tree.find(key);
+        elapsed += Clock::now() - start;
+        ops += queries.size();
+    } while (elapsed.count() < MIN_TIME * 1e9);
+
+    EXPECT(found > 0, "No keys found");
+    return elapsed.count() / ops;
+}
+
+template<int B>
+void find_with_b(const vector<int> &keys, const vector<int> &queries)
+{
+    cout << B/2 << " " << B << " " << keys.size()
+         << " " << ns_per_find<ab_tree>(B/2, B, keys, queries)
+         << " " << ns_per_find<basic_ab_tree<inline_ab_node<B>>>(B/2, B, keys, queries)
+         << endl;
+}
+
+void test_find()
+{
+    const int n = 1 << 20;
+    ChurningSet set(n);
+    vector<int> queries;
+    for (int i=0; i<n; i++)
+        queries.push_back(rng->next_range(4*n));
+
+#if defined(AB_TREE_NO_SIMD) || !defined(__SSE2__)
+    cout << "# Search in nodes: scalar" << endl;
+#elif defined(__AVX2__)
+    cout << "# Search in nodes: AVX2" << endl;
+#else
+    cout << "# Search in nodes: SSE2" << endl;
+#endif
+    cout << "# a b n ns_vector ns_inline" << endl;
+    find_with_b<4>(set.get_keys(), queries);
+    find_with_b<8>(set.get_keys(), queries);
+    find_with_b<16>(set.get_keys(), queries);
+    find_with_b<32>(set.get_keys(), queries);
+    find_with_b<64>(set.get_keys(), queries);
+    find_with_b<128>(set.get_keys(), queries);
+    find_with_b<256>(set.get_keys(), queries);
+}
+
+/*
+ *  Bulk test: building a tree from n sorted keys by inserting them one by one
+ *  and by bulk loading with fill factors 1 and 0.5. We print a, b, n and
+ *  for each method nanoseconds per key and nodes per key.
+ */
+void test_bulk()
+{
+    cout << "# a b n ns_insert nodes_insert ns_bulk nodes_bulk ns_bulk_half nodes_bulk_half" << endl;
+    for (auto [a, b] : degrees) {
+        for (int e=40; e<=88; e+=8) {
+            int n = (int) pow(2, e/4.);
+            vector<int> keys;
+            for (int i=0; i<n; i++)
+                keys.push_back(2*i);
+
+            cout << a << " " << b << " " << n;
+            for (double fill : { -1., 1., .5 }) {
+                // fill < 0 means inserting
+                long built = 0;
+                double nodes_per_key = 0;
+                chrono::duration<double, nano> elapsed(0);
+                do {
+                    ab_tree tree(a, b);
+                    auto start = Clock::now();
+                    if (fill < 0) {
+                        for (int key : keys)
+                            tree.insert(key);
+                    } else {
+                        tree.bulk_load(keys.begin(), keys.end(), fill);
+                    }
+                    elapsed += Clock::now() - start;
+                    nodes_per_key = (double) tree.num_nodes / n;
+                    built++;
+                } while (elapsed.count() < MIN_TIME * 1e9);
+
+                cout << " " << elapsed.count() / (built * n) << " " << nodes_per_key;
+            }
+            cout << endl;
+        }
+    }
+}
+
+/*
+ *  Range test: queries for all keys in a random interval of length len
+ *  in a set of n random keys. The (a,b)-tree has to walk its subtrees
+ *  recursively, the B+-tree descends once and then follows the leaves.
+ *  For each b, we print a=b/2, b, len and nanoseconds per query in both trees.
+ */
+
+// Append keys of the subtree between lo and hi inclusive to out.
+void ab_collect(ab_node *n, int lo, int hi, vector<int> &out)
+{
+    if (!n)
+        return;
+    std::size_t i;
+    n->find_branch(lo, i);
+    for (; i <= n->keys.size(); i++) {
+        ab_collect(n->children[i], lo, hi, out);
+        if (i == n->keys.size() || n->keys[i] > hi)
+            return;
+        out.push_back(n->keys[i]);
+    }
+}
+
+template<typename Tree, typename Collect>
+double ns_per_range(Tree &tree, const vector<int> &starts, int len, Collect collect)
+{
+    vector<int> out;
+    long found = 0, ops = 0;
+    chrono::duration<double, nano> elapsed(0);
+    do {
+        auto start = Clock::now();
+        for (int lo : starts) {
+            out.clear();
+            collect(tree, lo, lo + len - 1, out);
+            found += out.size();
+        }
+        elapsed += Clock::now() - start;
+        ops += starts.size();
+    } while (elapsed.count() < MIN_TIME * 1e9);
+
+    EXPECT(found > 0, "No keys found");
+    return elapsed.count() / ops;
+}
+
+void test_range()
+{
+    const int n = 1 << 20;
+    ChurningSet set(n);
+    vector<int> starts;
+    for (int i=0; i<1000; i++)
+        starts.push_back(rng->next_range(4*n));
+
+    cout << "# a b len ns_ab ns_bplus" << endl;
+    for (int b : { 8, 16, 64, 256 }) {
+        ab_tree ab(b/2, b);
+        bplus_tree bplus(b/2, b);
+        for (int key : set.get_keys()) {
+            ab.insert(key);
+            bplus.insert(key);
+        }
+
+        for (int len : { 10, 100, 1000, 10000, 100000 }) {
+            for (int lo : starts) {
+                vector<int> from_ab, from_bplus;
+                ab_collect(ab.root, lo, lo + len - 1, from_ab);
+                bplus.collect(lo, lo + len - 1, from_bplus);
+                EXPECT(from_ab == from_bplus, "Range queries disagree");
+            }
+
+            cout << b/2 << " " << b << " " << len
+                 << " " << ns_per_range(ab, starts, len, [](ab_tree &t, int lo, int hi, vector<int> &out) { ab_collect(t.root, lo, hi, out); })
+                 << " " << ns_per_range(bplus, starts, len, [](bplus_tree &t, int lo, int hi, vector<int> &out) { t.collect(lo, hi, out); })
+                 << endl;
+        }
+    }
+}
+
+/*
+ *  Allocation test: inserting n random keys into an empty tree.
+ *  We print a, b, n, nanoseconds per insert, memory allocations per insert
+ *  and new nodes per insert. Apart from creating nodes (3 allocations for
+ *  nodes with vectors, 1 for inline nodes), inserts should not allocate.
+ */
+template<typename Tree>
+void alloc_with(int a, int b, const vector<int> &keys)
+{
+    long built = 0, allocations = 0, nodes = 0;
+    chrono::duration<double, nano> elapsed(0);
+    do {
+        Tree tree(a, b);
+        long before = num_allocations;
+        int nodes_before = tree.num_nodes;
+
+        auto start = Clock::now();
+        for (int key : keys)
+            tree.insert(key);
+        elapsed += Clock::now() - start;
+
+        allocations += num_allocations - before;
+        nodes += tree.num_nodes - nodes_before;
+        built++;
+    } while (elapsed.count() < MIN_TIME * 1e9);
+
+    double inserts = (double) built * keys.size();
+    cout << a << " " << b << " " << keys.size()
+         << " " << elapsed.count() / inserts
+         << " " << allocations / inserts
+         << " " << nodes / inserts << endl;
+}
+
+void test_alloc()
+{
+    ChurningSet set(1 << 20);
+
+    cout << "# Nodes with vectors" << endl;
+    cout << "# a b n ns_per_insert allocs_per_insert nodes_per_insert" << endl;
+    for (auto [a, b] : degrees)
+        alloc_with<ab_tree>(a, b, set.get_keys());
+
+    cout << "# Inline nodes" << endl;
+    alloc_with<basic_ab_tree<inline_ab_node<3>>>(2, 3, set.get_keys());
+    alloc_with<basic_ab_tree<inline_ab_node<4>>>(2, 4, set.get_keys());
+    alloc_with<basic_ab_tree<inline_ab_node<16>>>(8, 16, set.get_keys());
+    alloc_with<basic_ab_tree<inline_ab_node<64>>>(32, 64, set.get_keys());
+    alloc_with<basic_ab_tree<inline_ab_node<256>>>(128, 256, set.get_keys());
+}
+
+/*
+ *  Paged test: a tree with n random keys in a file with 4 KiB pages.
+ *  After building it, we write it to the disk, ask the kernel to drop
+ *  the file from the page cache and open it again. Then we measure
+ *  random finds twice: cold (pages are read from the disk on demand)
+ *  and warm (all pages on the path are already in memory).
+ *  We print n, the number of pages, the time to open the tree
+ *  in microseconds and nanoseconds per cold and warm find.
+ */
+void test_paged()
+{
+    const char *path = "ab_tree_experiment.pages";
+    const int b = paged_ab_tree::MAX_B;
+    vector<int> queries;
+    for (int i=0; i<10000; i++)
+        queries.push_back(rng->next_u32());
+
+    cout << "# n pages open_us ns_cold ns_warm" << endl;
+    for (int e=64; e<=88; e+=8) {
+        int n = (int) pow(2, e/4.);
+        unlink(path);
+        {
+            paged_ab_tree tree(path, b/2, b);
+            for (int i=0; i<n; i++)
+                tree.insert(rng->next_u32());
+            tree.sync();
+        }
+
+        int fd = open(path, O_RDONLY);
+        EXPECT(fd >= 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0, "Cannot drop the file from the page cache");
+        close(fd);
+
+        auto start = Clock::now();
+        paged_ab_tree tree(path, b/2, b);
+        chrono::duration<double, micro> open_time = Clock::now() - start;
+
+        cout << n << " " << tree.num_pages() << " " << open_time.count();
+        long found = 0;
+        for (int pass=0; pass<2; pass++) {
+            start = Clock::now();
+            for (int key : queries)
+                found += tree.find(key);
+            chrono::duration<double, nano> elapsed = Clock::now() - start;
+            cout << " " << elapsed.count() / queries.size();
+        }
+        cout << endl;
+        sink = found;
+    }
+    unlink(path);
+}
+
+/*
+ *  Batch test: finding random keys (about 1/4 of them present) in a tree
+ *  with n random keys one by one and using find_batch. We print a, b, n
+ *  and nanoseconds per key for both ways.
+ *
+ *  Every tree starts with the memory of the previous ones returned, so that
+ *  the results do not depend on the order of trees. Before measuring, both
+ *  ways are run once, so that one-time costs are not charged to either.
+ */
+template<typename Tree>
+void batch_with(int a, int b, const vector<int> &keys, const vector<int> &queries)
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    Tree tree(a, b);
+    for (int key : keys)
+        tree.insert(key);
+
+    chrono::duration<double, nano> single(0), batched(0);
+    long rounds = 0, found = 0;
+    vector<bool> results;
+    for (int key : queries)
+        found -= tree.find(key);
+    tree.find_batch(queries, results);
+    for (std::size_t j=0; j < queries.size(); j++)
+        found += results[j];
+    EXPECT(found == 0, "Batched find differs from find");
+
+    do {
+        auto start = Clock::now();
+        for (int key : queries)
+            found += tree.find(key);
+        auto middle = Clock::now();
+        tree.find_batch(queries, results);
+        auto end = Clock::now();
+
+        single += middle - start;
+        batched += end - middle;
+        rounds++;
+    } while ((single + batched).count() < MIN_TIME * 1e9);
+    sink = found;
+
+    cout << a << " " << b << " " << keys.size()
+         << " " << single.count() / (rounds * queries.size())
+         << " " << batched.count() / (rounds * queries.size()) << endl;
+}
+
+void test_batch()
+{
+    ChurningSet set(1 << 20);
+    vector<int> queries;
+    for (int i=0; i<100000; i++)
+        queries.push_back(rng->next_range(4 << 20));
+
+    cout << "# Nodes with vectors" << endl;
+    cout << "# a b n ns_find ns_batch" << endl;
+    for (auto [a, b] : degrees)
+        batch_with<ab_tree>(a, b, set.get_keys(), queries);
+
+    cout << "# Inline nodes" << endl;
+    batch_with<basic_ab_tree<inline_ab_node<3>>>(2, 3, set.get_keys(), queries);
+    batch_with<basic_ab_tree<inline_ab_node<4>>>(2, 4, set.get_keys(), queries);
+    batch_with<basic_ab_tree<inline_ab_node<16>>>(8, 16, set.get_keys(), queries);
+    batch_with<basic_ab_tree<inline_ab_node<64>>>(32, 64, set.get_keys(), queries);
+    batch_with<basic_ab_tree<inline_ab_node<256>>>(128, 256, set.get_keys(), queries);
+}
+
+vector<pair<string, function<void()>>> tests = {
+    { "churn",        test_churn },
+    { "churn-inline", test_churn_inline },
+    { "find",         test_find },
+    { "bulk",         test_bulk },
+    { "range",        test_range },
+    { "alloc",        test_alloc },
+    { "paged",        test_paged },
+    { "batch",        test_batch },
+};
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " <test> <student-id>" << endl;
+        return 1;
+    }
+
+    string which_test = argv[1];
+    string id_str = argv[2];
+
+    try {
+        rng = new RandomGen(stoi(id_str));
+    } catch (...) {
+        cerr << "Invalid student ID" << endl;
+        return 1;
+    }
+
+    for (const auto& test : tests) {
+        if (test.first == which_test) {
+            cout.precision(12);
+            test.second();
+            return 0;
+        }
+    }
+    cerr << "Unknown test " << which_test << endl;
+    return 1;
+}
@@ -1,12 +1,19 @@
 #include <functional>
+#include <iterator>
+#include <sstream>
 #include <cstdlib>
+#include <thread>
 #include <vector>
 
 #include "ab_tree.h"
+#include "bplus_tree.h"
+#include "olc_ab_tree.h"
+#include "paged_ab_tree.h"
 
 // Debugging output: showing trees prettily on standard output.
 
-void ab_tree::show()
+template<typename Node>
+void basic_ab_tree<Node>::show()
 {
     root->show(0);
     for (int i=0; i<70; i++)
@@ -14,7 +21,8 @@ void ab_tree::show()
     cout << endl;
 }
 
-void ab_node::show(int indent)
+template<typename Self, typename Keys, typename Children>
+void basic_ab_node<Self, Keys, Children>::show(int indent)
 {
     for (int i = children.size() - 1; i >= 0 ; i--) {
         if (i < keys.size()) {
@@ -29,7 +37,8 @@ void ab_node::show(int indent)
 
 // Invariant checks
 
-void audit_subtree(ab_tree *tree, ab_node *n, int key_min, int key_max, int depth, int &leaf_depth)
+template<typename Node>
+void audit_subtree(basic_ab_tree<Node> *tree, Node *n, int key_min, int key_max, int depth, int &leaf_depth)
 {
     if (!n) {
         // Check that all leaves are on the same level.
@@ -73,13 +82,181 @@ void audit_subtree(ab_tree *tree, ab_node *n, int key_min, int key_max, int dept
     }
 }
 
-void ab_tree::audit()
+template<typename Node>
+void basic_ab_tree<Node>::audit()
 {
     EXPECT(root, "Tree has no root");
     int leaf_depth = -1;
     audit_subtree(this, root, numeric_limits<int>::min(), numeric_limits<int>::max(), 0, leaf_depth);
 }
 
+// The same for B+-trees
+
+void bplus_tree::show()
+{
+    root->show(0);
+    for (int i=0; i<70; i++)
+        cout << '=';
+    cout << endl;
+}
+
+void bplus_node::show(int indent)
+{
+    if (is_leaf()) {
+        for (int j = 0; j < indent; j++)
+            cout << "    ";
+        for (int key : keys)
+            cout << key << " ";
+        cout << endl;
+        return;
+    }
+    for (int i = children.size() - 1; i >= 0 ; i--) {
+        children[i]->show(indent+1);
+        if (i > 0) {
+            for (int j = 0; j < indent; j++)
+                cout << "    ";
+            cout << keys[i-1] << endl;
+        }
+    }
+}
+
+// Keys of the subtree must lie in [key_min, key_max). Leaves are appended to `leaves`.
+void audit_bplus_subtree(bplus_tree *tree, bplus_node *n, long key_min, long key_max, int depth, int &leaf_depth, vector<bplus_node *> &leaves)
+{
+    // Check order of keys: they must be increasing and bounded by the keys on the higher levels.
+    for (int i = 0; i < n->keys.size(); i++) {
+        EXPECT(n->keys[i] >= key_min && n->keys[i] < key_max, "Wrong key order");
+        EXPECT(i == 0 || n->keys[i-1] < n->keys[i], "Wrong key order");
+    }
+
+    if (n->is_leaf()) {
+        // Check that all leaves are on the same level.
+        if (leaf_depth < 0)
+            leaf_depth = depth;
+        else
+            EXPECT(depth == leaf_depth, "Leaves are not on the same level");
+
+        if (depth > 0)
+            EXPECT(n->keys.size() >= tree->a - 1, "Too few keys in a leaf");
+        EXPECT(n->keys.size() <= tree->b - 1, "Too many keys in a leaf");
+        leaves.push_back(n);
+        return;
+    }
+
+    // The number of children must be in the allowed range.
+    EXPECT(n->children.size() >= (depth > 0 ? tree->a : 2), "Too few children");
+    EXPECT(n->children.size() <= tree->b, "Too many children");
+
+    // We must have one more children than keys.
+    EXPECT(n->children.size() == n->keys.size() + 1, "Number of keys does not match number of children");
+
+    EXPECT(!n->next, "Internal node linked to the next leaf");
+
+    // Call on children recursively.
+    for (int i = 0; i < n->children.size(); i++) {
+        long tmin = (i == 0) ? key_min : n->keys[i-1];
+        long tmax = (i < n->keys.size()) ? n->keys[i] : key_max;
+        audit_bplus_subtree(tree, n->children[i], tmin, tmax, depth+1, leaf_depth, leaves);
+    }
+}
+
+void bplus_tree::audit()
+{
+    EXPECT(root, "Tree has no root");
+    int leaf_depth = -1;
+    vector<bplus_node *> leaves;
+    audit_bplus_subtree(this, root, numeric_limits<int>::min(), (long) numeric_limits<int>::max() + 1, 0, leaf_depth, leaves);
+
+    // The leaves must be chained in the order of keys.
+    for (int i = 0; i < leaves.size(); i++)
+        EXPECT(leaves[i]->next == (i+1 < leaves.size() ? leaves[i+1] : nullptr), "Leaves are not linked properly");
+}
+
+// The same for concurrent trees
+
+template<int B>
+void audit_olc_subtree(olc_ab_tree<B> *tree, olc_ab_node<B> *n, long key_min, long key_max, int depth, int &leaf_depth)
+{
+    if (!n) {
+        // Check that all leaves are on the same level.
+        if (leaf_depth < 0)
+            leaf_depth = depth;
+        else
+            EXPECT(depth == leaf_depth, "Leaves are not on the same level");
+        return;
+    }
+
+    // The number of children must be in the allowed range.
+    int num_children = n->num_keys + 1;
+    if (depth > 0)
+        EXPECT(num_children >= tree->a, "Too few children");
+    EXPECT(num_children <= tree->b, "Too many children");
+
+    // Check order of keys: they must be increasing and bounded by the keys on the higher levels.
+    for (int i = 0; i < n->num_keys; i++) {
+        EXPECT(n->keys[i] >= key_min && n->keys[i] <= key_max, "Wrong key order");
+        EXPECT(i == 0 || n->keys[i-1] < n->keys[i], "Wrong key order");
+    }
+
+    // Call on children recursively.
+    for (int i = 0; i < num_children; i++) {
+        long tmin = (i == 0) ? key_min : n->keys[i-1] + 1L;
+        long tmax = (i < n->num_keys) ? n->keys[i] - 1L : key_max;
+        audit_olc_subtree(tree, n->children[i], tmin, tmax, depth+1, leaf_depth);
+    }
+}
+
+template<int B>
+void olc_ab_tree<B>::audit()
+{
+    EXPECT(root, "Tree has no root");
+    int leaf_depth = -1;
+    audit_olc_subtree(this, root.load(), numeric_limits<int>::min(), numeric_limits<int>::max(), 0, leaf_depth);
+}
+
+// The same for trees in files
+
+void audit_paged_subtree(paged_ab_tree *tree, paged_ab_tree::page_id id, long key_min, long key_max, int depth, int &leaf_depth)
+{
+    if (!id) {
+        // Check that all leaves are on the same level.
+        if (leaf_depth < 0)
+            leaf_depth = depth;
+        else
+            EXPECT(depth == leaf_depth, "Leaves are not on the same level");
+        return;
+    }
+
+    EXPECT(id < tree->num_pages(), "Child page out of range");
+    const paged_ab_tree::node *n = tree->page(id);
+
+    // The number of children must be in the allowed range.
+    int num_children = n->num_keys + 1;
+    if (depth > 0)
+        EXPECT(num_children >= tree->a, "Too few children");
+    EXPECT(num_children <= tree->b, "Too many children");
+
+    // Check order of keys: they must be increasing and bounded by the keys on the higher levels.
+    for (int i = 0; i < n->num_keys; i++) {
+        EXPECT(n->keys[i] >= key_min && n->keys[i] <= key_max, "Wrong key order");
+        EXPECT(i == 0 || n->keys[i-1] < n->keys[i], "Wrong key order");
+    }
+
+    // Call on children recursively.
+    for (int i = 0; i < num_children; i++) {
+        long tmin = (i == 0) ? key_min : n->keys[i-1] + 1L;
+        long tmax = (i < n->num_keys) ? n->keys[i] - 1L : key_max;
+        audit_paged_subtree(tree, n->children[i], tmin, tmax, depth+1, leaf_depth);
+    }
+}
+
+void paged_ab_tree::audit()
+{
+    EXPECT(root(), "Tree has no root");
+    int leaf_depth = -1;
+    audit_paged_subtree(this, root(), numeric_limits<int>::min(), numeric_limits<int>::max(), 0, leaf_depth);
+}
+
 // A basic test: insert a couple of keys and show how the tree evolves.
 
 void test_basic()
@@ -102,11 +279,12 @@ void test_basic()
 // The main test: inserting a lot of keys and checking that they are really there.
 // We will insert num_items keys from the set {1,...,range-1}, where range is a prime.
 
+template<typename Tree>
 void test_main(int a, int b, int range, int num_items)
 {
     // Create a new tree.
     cout << "## Test: a=" << a << " b=" << b << " range=" << range << " num_items=" << num_items << endl;
-    ab_tree t(a, b);
+    Tree t(a, b);
 
     int key = 1;
     int step = (int)(range * 1.618);
@@ -135,14 +313,315 @@ void test_main(int a, int b, int range, int num_items)
     }
 }
 
+// Removing keys from a small tree, including keys in internal nodes.
+
+void test_basic_remove()
+{
+    cout << "## Basic remove test" << endl;
+
+    ab_tree t(2, 3);
+    for (int k=0; k<10; k++)
+        t.insert(k);
+    t.show();
+
+    EXPECT(!t.remove(10), "Removed a key which was not present");
+
+    vector<int> keys = { 3, 1, 4, 5, 9, 2, 6, 8, 7, 0 };
+    for (int i=0; i < keys.size(); i++) {
+        EXPECT(t.remove(keys[i]), "Key to be removed was not found");
+        t.show();
+        t.audit();
+        EXPECT(!t.find(keys[i]), "Removed key is still present");
+        for (int j=i+1; j < keys.size(); j++)
+            EXPECT(t.find(keys[j]), "Some keys are missing after remove");
+    }
+
+    EXPECT(t.num_nodes == 1, "Empty tree should consist of the root only");
+}
+
+// Insert keys like test_main does, then remove every other of them
+// and finally the rest, checking the contents on the way.
+
+template<typename Tree>
+void test_remove(int a, int b, int range, int num_items)
+{
+    cout << "## Remove test: a=" << a << " b=" << b << " range=" << range << " num_items=" << num_items << endl;
+    Tree t(a, b);
+
+    int step = (int)(range * 1.618);
+    vector<int> keys;
+    int key = 1;
+    for (int i=1; i <= num_items; i++) {
+        t.insert(key);
+        keys.push_back(key);
+        key = (key + step) % range;
+    }
+
+    for (int pass=0; pass<2; pass++) {
+        int audit_time = 1;
+        for (int i=pass; i < keys.size(); i+=2) {
+            EXPECT(t.remove(keys[i]), "Key to be removed was not found");
+            EXPECT(!t.remove(keys[i]), "Key was removed twice");
+            if (i/2 == audit_time || i+2 >= keys.size()) {
+                t.audit();
+                audit_time = (int)(audit_time * 1.33) + 1;
+            }
+        }
+
+        for (int i=0; i < keys.size(); i++)
+            EXPECT(t.find(keys[i]) == (pass == 0 && i % 2), "Tree contains wrong keys");
+    }
+
+    EXPECT(t.num_nodes == 1, "Empty tree should consist of the root only");
+}
+
+// Bulk loading sorted sequences of all lengths up to 200 with different fill
+// factors, then checking that the tree is valid and can be modified further.
+
+template<typename Tree>
+void test_bulk_load(int a, int b)
+{
+    cout << "## Bulk load test: a=" << a << " b=" << b << endl;
+
+    for (double fill : { 0.0, 0.5, 0.75, 1.0 }) {
+        for (int n=0; n<=200; n++) {
+            // Odd keys with a duplicate, which should be skipped
+            vector<int> keys;
+            for (int i=0; i<n; i++)
+                keys.push_back(2*i + 1);
+            if (n > 0)
+                keys.push_back(2*n - 1);
+
+            Tree t(a, b);
+            t.insert(1000);
+            t.bulk_load(keys.begin(), keys.end(), fill);
+            t.audit();
+
+            for (int k=0; k <= 2*n + 1; k++)
+                EXPECT(t.find(k) == (k % 2 == 1 && k < 2*n), "Bulk loaded tree contains wrong keys");
+
+            for (int k=0; k <= 2*n + 1; k+=2)
+                t.insert(k);
+            t.audit();
+            for (int i=0; i<n; i++)
+                EXPECT(t.remove(2*i + 1), "Bulk loaded key cannot be removed");
+            t.audit();
+        }
+    }
+
+    // The range can be read just once
+    stringstream in;
+    for (int i=0; i<10000; i++)
+        in << i/2 << " ";
+    Tree t(a, b);
+    t.bulk_load(istream_iterator<int>(in), istream_iterator<int>());
+    t.audit();
+    for (int k=-1; k<=5000; k++)
+        EXPECT(t.find(k) == (k >= 0 && k < 5000), "Tree loaded from a stream contains wrong keys");
+}
+
+// B+-trees: insert keys like test_main does, then check finds, iteration
+// and range queries against a sorted vector of the same keys.
+
+void test_bplus(int a, int b, int range, int num_items, bool show)
+{
+    cout << "## B+-tree test: a=" << a << " b=" << b << " range=" << range << " num_items=" << num_items << endl;
+    bplus_tree t(a, b);
+    EXPECT(t.begin() == t.end(), "Empty tree has keys");
+
+    int key = 1;
+    int step = (int)(range * 1.618);
+    int audit_time = 1;
+    vector<int> keys;
+
+    for (int i=1; i <= num_items; i++) {
+        t.insert(key);
+        keys.push_back(key);
+        if (show)
+            t.show();
+        if (i == audit_time || i == num_items) {
+            t.audit();
+            audit_time = (int)(audit_time * 1.33) + 1;
+        }
+        key = (key + step) % range;
+    }
+    t.insert(keys[0]);
+    t.audit();
+
+    sort(keys.begin(), keys.end());
+    for (int k=0; k < range; k++)
+        EXPECT(t.find(k) == binary_search(keys.begin(), keys.end(), k), "Tree contains wrong keys");
+
+    EXPECT(vector<int>(t.begin(), t.end()) == keys, "Iteration does not give all keys in order");
+
+    for (int lo=-1; lo <= range; lo += 1 + range/50) {
+        for (int len : { 0, 1, 10, range/3, range }) {
+            vector<int> got;
+            t.collect(lo, lo + len, got);
+            vector<int> expected(lower_bound(keys.begin(), keys.end(), lo), upper_bound(keys.begin(), keys.end(), lo + len));
+            EXPECT(got == expected, "Range query gives wrong keys");
+
+            auto it = t.lower_bound(lo);
+            auto expected_it = lower_bound(keys.begin(), keys.end(), lo);
+            EXPECT((it == t.end()) == (expected_it == keys.end()), "Wrong lower bound");
+            EXPECT(it == t.end() || *it == *expected_it, "Wrong lower bound");
+        }
+    }
+}
+
+// Concurrent trees: several threads insert disjoint sets of keys
+// and look up keys of the others, then we check the result.
+
+template<int B>
+void test_olc(int a, int b, int num_threads, int keys_per_thread)
+{
+    cout << "## Concurrent test: a=" << a << " b=" << b << " threads=" << num_threads << " keys_per_thread=" << keys_per_thread << endl;
+    olc_ab_tree<B> t(a, b);
+
+    // Thread j inserts keys congruent to j modulo num_threads in a scrambled order.
+    const int range = num_threads * keys_per_thread;
+    const int step = 7919;
+    vector<thread> threads;
+    for (int j=0; j<num_threads; j++)
+        threads.emplace_back([&t, j, num_threads, keys_per_thread, range] {
+            for (int i=0; i<keys_per_thread; i++) {
+                int key = ((long) i * step % keys_per_thread) * num_threads + j;
+                t.insert(key);
+                EXPECT(t.find(key), "Inserted key disappeared");
+                t.find((key + 1) % range);
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+
+    t.audit();
+    for (int k=-1; k <= range; k++)
+        EXPECT(t.find(k) == (k >= 0 && k < range), "Tree contains wrong keys");
+}
+
+// Trees in files: insert keys like test_main does in two sessions,
+// then open the file again and check its contents.
+
+void test_paged(int a, int b, int range, int num_items)
+{
+    cout << "## Paged test: a=" << a << " b=" << b << " range=" << range << " num_items=" << num_items << endl;
+
+    char path[] = "/tmp/ab_tree_test.XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT(fd >= 0, "Cannot create a temporary file");
+    close(fd);
+
+    int step = (int)(range * 1.618);
+    int key = 1;
+    for (int session=0; session<2; session++) {
+        paged_ab_tree t(path, a, b);
+        for (int i = session * num_items/2 + 1; i <= (session+1) * num_items/2; i++) {
+            t.insert(key);
+            key = (key + step) % range;
+        }
+        t.audit();
+    }
+
+    paged_ab_tree t(path, a, b);
+    t.audit();
+    key = 1;
+    for (int i=1; i < range; i++) {
+        EXPECT(t.find(key) == (i <= num_items/2 * 2), "Tree contains wrong keys");
+        key = (key + step) % range;
+    }
+
+    unlink(path);
+}
+
+// Batched finds must give the same results as single ones,
+// including batches which are not a multiple of the group size.
+
+template<typename Tree>
+void test_find_batch(int a, int b)
+{
+    cout << "## Batched find test: a=" << a << " b=" << b << endl;
+    Tree t(a, b);
+    for (int k=0; k<30000; k+=3)
+        t.insert(k);
+
+    vector<bool> results;
+    for (int n : { 0, 1, 15, 16, 17, 1000, 40000 }) {
+        vector<int> keys;
+        for (int i=0; i<n; i++)
+            keys.push_back((i * 7919) % 30001 - 1);
+
+        t.find_batch(keys, results);
+        EXPECT(results.size() == keys.size(), "Wrong number of results");
+        for (int i=0; i<n; i++)
+            EXPECT(results[i] == t.find(keys[i]), "Batched find differs from find");
+    }
+}
+
+// Compare the vectorized search in a node with the scalar one
+// on random sorted arrays of all lengths up to 300.
+
+void test_rank()
+{
+    srand(42);
+    for (int n=0; n<=300; n++) {
+        vector<int> keys;
+        int key = numeric_limits<int>::min();
+        for (int i=0; i<n; i++) {
+            key += 1 + rand() % 10;
+            keys.push_back(key);
+        }
+
+        vector<int> queries = { numeric_limits<int>::min(), numeric_limits<int>::max() };
+        for (int k : keys) {
+            queries.push_back(k - 1);
+            queries.push_back(k);
+            queries.push_back(k + 1);
+        }
+
+        for (int q : queries)
+            EXPECT(ab_rank(keys.data(), n, q) == ab_rank_scalar(keys.data(), n, q), "Vectorized search gives a wrong result");
+    }
+}
+
 /*** A list of all tests ***/
 
 vector<pair<string, function<void()>>> tests = {
     { "basic",       [] { test_basic(); } },
-    { "small-2,3",   [] { test_main(2, 3, 997, 700); } },
-    { "small-2,4",   [] { test_main(2, 4, 997, 700); } },
-    { "big-2,3",     [] { test_main(2, 3, 999983, 700000); } },
-    { "big-2,4",     [] { test_main(2, 4, 999983, 700000); } },
-    { "big-10,20",   [] { test_main(10, 20, 999983, 700000); } },
-    { "big-100,200", [] { test_main(100, 200, 999983, 700000); } },
+    { "small-2,3",   [] { test_main<ab_tree>(2, 3, 997, 700); } },
+    { "small-2,4",   [] { test_main<ab_tree>(2, 4, 997, 700); } },
+    { "big-2,3",     [] { test_main<ab_tree>(2, 3, 999983, 700000); } },
+    { "big-2,4",     [] { test_main<ab_tree>(2, 4, 999983, 700000); } },
+    { "big-10,20",   [] { test_main<ab_tree>(10, 20, 999983, 700000); } },
+    { "big-100,200", [] { test_main<ab_tree>(100, 200, 999983, 700000); } },
+    { "remove-basic",       [] { test_basic_remove(); } },
+    { "remove-small-2,3",   [] { test_remove<ab_tree>(2, 3, 997, 700); } },
+    { "remove-small-2,4",   [] { test_remove<ab_tree>(2, 4, 997, 700); } },
+    { "remove-big-2,3",     [] { test_remove<ab_tree>(2, 3, 999983, 700000); } },
+    { "remove-big-10,20",   [] { test_remove<ab_tree>(10, 20, 999983, 700000); } },
+    { "remove-big-100,200", [] { test_remove<ab_tree>(100, 200, 999983, 700000); } },
+    { "inline-small-2,3",   [] { test_main<basic_ab_tree<inline_ab_node<3>>>(2, 3, 997, 700); } },
+    { "inline-big-2,4",     [] { test_main<basic_ab_tree<inline_ab_node<4>>>(2, 4, 999983, 700000); } },
+    { "inline-big-10,20",   [] { test_main<basic_ab_tree<inline_ab_node<32>>>(10, 20, 999983, 700000); } },
+    { "inline-remove-2,3",  [] { test_remove<basic_ab_tree<inline_ab_node<3>>>(2, 3, 999983, 700000); } },
+    { "inline-remove-100,200", [] { test_remove<basic_ab_tree<inline_ab_node<200>>>(100, 200, 999983, 700000); } },
+    { "rank",        [] { test_rank(); } },
+    { "bulk-2,3",          [] { test_bulk_load<ab_tree>(2, 3); } },
+    { "bulk-2,4",          [] { test_bulk_load<ab_tree>(2, 4); } },
+    { "bulk-3,5",          [] { test_bulk_load<ab_tree>(3, 5); } },
+    { "bulk-inline-10,20", [] { test_bulk_load<basic_ab_tree<inline_ab_node<20>>>(10, 20); } },
+    { "bplus-basic",     [] { test_bplus(2, 3, 11, 10, true); } },
+    { "bplus-small-2,3", [] { test_bplus(2, 3, 997, 700, false); } },
+    { "bplus-small-3,5", [] { test_bplus(3, 5, 997, 700, false); } },
+    { "bplus-big-2,4",   [] { test_bplus(2, 4, 99991, 70000, false); } },
+    { "bplus-big-32,64", [] { test_bplus(32, 64, 99991, 70000, false); } },
+    { "olc-single-2,4",    [] { test_olc<4>(2, 4, 1, 10000); } },
+    { "olc-threads-2,4",   [] { test_olc<4>(2, 4, 4, 50000); } },
+    { "olc-threads-8,16",  [] { test_olc<16>(8, 16, 8, 50000); } },
+    { "olc-threads-32,64", [] { test_olc<64>(32, 64, 4, 100000); } },
+    { "paged-2,3",     [] { test_paged(2, 3, 9973, 7000); } },
+    { "paged-10,20",   [] { test_paged(10, 20, 999983, 700000); } },
+    { "paged-255,510", [] { test_paged(255, 510, 999983, 700000); } },
+    { "batch-2,3",         [] { test_find_batch<ab_tree>(2, 3); } },
+    { "batch-10,20",       [] { test_find_batch<ab_tree>(10, 20); } },
+    { "batch-inline-8,16", [] { test_find_batch<basic_ab_tree<inline_ab_node<16>>>(8, 16); } },
 };
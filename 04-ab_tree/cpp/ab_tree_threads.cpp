@@ -0,0 +1,101 @@
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ab_tree.h"
+#include "olc_ab_tree.h"
+#include "random.h"
+#include "throughput.h"
+
+void expect_failed(const string& message) {
+    cerr << "Error: " << message << endl;
+    exit(1);
+}
+
+/*
+ *  Multi-threaded throughput of shared (a,b)-trees.
+ *
+ *  All threads operate on one tree with about N keys from [0, 2N):
+ *  95% of operations are finds of random keys, the rest are inserts.
+ *  For every number of threads up to the number of CPUs, we report
+ *  the total number of operations per second.
+ */
+
+constexpr int N = 1 << 20;
+constexpr int A = 16, B = 32;       // Degrees of the trees
+constexpr double DURATION = .5;     // Seconds per measurement
+
+// The baseline: a single tree behind a readers-writer lock.
+class LockedTree {
+    shared_mutex lock;
+    ab_tree tree{A, B};
+
+  public:
+    bool find(int key)
+    {
+        shared_lock<shared_mutex> guard(lock);
+        return tree.find(key);
+    }
+
+    void insert(int key)
+    {
+        unique_lock<shared_mutex> guard(lock);
+        tree.insert(key);
+    }
+};
+
+// The tree with optimistic lock coupling.
+class OLCTree : public olc_ab_tree<B> {
+  public:
+    OLCTree() : olc_ab_tree<B>(A, B) {}
+};
+
+int seed;               // Random seed given on the command line
+
+template<typename SharedTree>
+void test_throughput()
+{
+    measure_throughput<SharedTree>(seed, DURATION, [](SharedTree &tree, RandomGen &rng) {
+        for (int i=0; i<N; i++)
+            tree.insert(rng.next_range(2*N));
+    }, [](SharedTree &tree, RandomGen &rng) {
+        unsigned what = rng.next_range(20);
+        int key = rng.next_range(2*N);
+        if (what < 19)
+            tree.find(key);
+        else
+            tree.insert(key);
+    });
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " <student-id> (rwlock|olc)" << endl;
+        return 1;
+    }
+
+    string mode = argv[2];
+
+    try {
+        seed = stoi(argv[1]);
+    } catch (...) {
+        cerr << "Invalid student ID" << endl;
+        return 1;
+    }
+
+    cout.precision(12);
+    if (mode == "rwlock")
+        test_throughput<LockedTree>();
+    else if (mode == "olc")
+        test_throughput<OLCTree>();
+    else {
+        cerr << "Last argument must be either 'rwlock' or 'olc'" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+#ifndef DS1_BPLUS_TREE_H
+#define DS1_BPLUS_TREE_H
+
+#include <iterator>
+#include <stack>
+#include <vector>
+
+#include "ab_tree.h"
+
+/*
+ *  B+-tree: a variant of the (a,b)-tree, which keeps all keys in the leaves.
+ *  Internal nodes contain only copies of keys, which separate their children,
+ *  and leaves are chained in increasing order of keys. A range query is
+ *  therefore a single descent followed by a sequential walk over leaves.
+ */
+
+/*** One node ***/
+
+class bplus_node {
+  public:
+    // Keys stored in this node. In internal nodes, children[i] contains
+    // keys less than keys[i] and children[i+1] keys greater or equal.
+    // Leaves have no children. The vectors are large enough to accomodate
+    // one extra entry in overflowing nodes.
+    vector<bplus_node *> children;
+    vector<int> keys;
+
+    // The next leaf in the order of keys (nullptr in internal nodes and in the last leaf)
+    bplus_node *next = nullptr;
+
+    bool is_leaf() const { return children.empty(); }
+
+    // Return the index of the child whose subtree can contain the given key.
+    std::size_t find_child(int key)
+    {
+        std::size_t i = ab_rank(keys.data(), keys.size(), key);
+        if (i < keys.size() && keys[i] == key)
+            i++;
+        return i;
+    }
+
+    // An auxiliary function for displaying a sub-tree under this node.
+    void show(int indent);
+};
+
+/*** Tree ***/
+
+class bplus_tree {
+  public:
+    int a;              // Minimum allowed number of children (and keys in a leaf + 1)
+    int b;              // Maximum allowed number of children (and keys in a leaf + 1)
+    bplus_node *root;   // Root node (a tree with no keys has an empty leaf as the root)
+    int num_nodes;      // We keep track of how many nodes the tree has
+
+    // Create a new node and return a pointer to it.
+    bplus_node *new_node()
+    {
+        bplus_node *n = new bplus_node;
+        n->keys.reserve(b);
+        num_nodes++;
+        return n;
+    }
+
+    // Delete a given node, assuming that its children have been already unlinked.
+    void delete_node(bplus_node *n)
+    {
+        num_nodes--;
+        delete n;
+    }
+
+    // Constructor: initialize an empty tree with just the root.
+    bplus_tree(int a, int b)
+    {
+        EXPECT(a >= 2 && b >= 2*a - 1, "Invalid values of a,b");
+        this->a = a;
+        this->b = b;
+        num_nodes = 0;
+        root = new_node();
+    }
+
+    // An auxiliary function for deleting a subtree recursively.
+    void delete_tree(bplus_node *n)
+    {
+        for (bplus_node *child : n->children)
+            delete_tree(child);
+        delete_node(n);
+    }
+
+    // Destructor: delete all nodes.
+    ~bplus_tree()
+    {
+        delete_tree(root);
+        EXPECT(num_nodes == 0, "Memory leak detected: some nodes were not deleted");
+    }
+
+    // Return the leaf whose range of keys contains the given key.
+    bplus_node *find_leaf(int key) const
+    {
+        bplus_node *n = root;
+        while (!n->is_leaf())
+            n = n->children[n->find_child(key)];
+        return n;
+    }
+
+    // Find a key: returns true if it is present in the tree.
+    bool find(int key) const
+    {
+        bplus_node *leaf = find_leaf(key);
+        std::size_t i = ab_rank(leaf->keys.data(), leaf->keys.size(), key);
+        return i < leaf->keys.size() && leaf->keys[i] == key;
+    }
+
+    // Display the tree on standard output in human-readable form.
+    void show();
+
+    // Check that the data structure satisfies all invariants.
+    void audit();
+
+    // Insert: add key to the tree (unless it was already present).
+    void insert(int key)
+    {
+        bplus_node *n = root;
+
+        // holds the path to the leaf, with the index of the child taken in each node
+        std::stack<std::pair<bplus_node * const, std::size_t>> parents;
+
+        while (!n->is_leaf()) {
+            std::size_t i = n->find_child(key);
+            parents.emplace(n, i);
+            n = n->children[i];
+        }
+
+        std::size_t i = ab_rank(n->keys.data(), n->keys.size(), key);
+        if (i < n->keys.size() && n->keys[i] == key)
+            return;
+        n->keys.insert(n->keys.begin() + i, key);
+
+        if (n->keys.size() < b)
+            return;
+
+        // splitting the leaf n into n and m, the first key of m goes up as a copy
+
+        bplus_node *m = new_node();
+        i = n->keys.size() / 2;
+        std::move(n->keys.begin() + i, n->keys.end(),
+            std::back_inserter(m->keys));
+        n->keys.erase(n->keys.begin() + i, n->keys.end());
+        m->next = n->next;
+        n->next = m;
+        key = m->keys.front();
+
+        while (true) {
+            if (n == root) {
+                // we need a new layer
+
+                root = new_node();
+                root->children.reserve(b+1);
+                root->children.emplace_back(n);
+                root->children.emplace_back(m);
+                root->keys.emplace_back(key);
+
+                return;
+            }
+
+            // we add m as n's right sibling and propagate upwards
+
+            const auto [parent, j] = parents.top();
+            parents.pop();
+
+            parent->keys.insert(parent->keys.begin() + j, key);
+            parent->children.insert(parent->children.begin() + j + 1, m);
+            n = parent;
+
+            if (n->keys.size() < b)
+                return;
+
+            // splitting the internal node n into n and m, the middle key moves up
+
+            m = new_node();
+            m->children.reserve(b+1);
+            i = n->keys.size() / 2 + 1;
+            key = n->keys[i - 1];
+
+            std::move(n->keys.begin() + i, n->keys.end(),
+                std::back_inserter(m->keys));
+            std::move(n->children.begin() + i, n->children.end(),
+                std::back_inserter(m->children));
+
+            n->keys.erase(n->keys.begin() + (i - 1), n->keys.end());
+            n->children.erase(n->children.begin() + i, n->children.end());
+        }
+    }
+
+    // Forward iterator over keys in increasing order.
+    class iterator {
+        const bplus_node *leaf;
+        std::size_t i;
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef int value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const int *pointer;
+        typedef const int &reference;
+
+        // Point to the i-th key of the leaf, or to the first key
+        // in the following leaves if the leaf has less keys.
+        iterator(const bplus_node *leaf=nullptr, std::size_t i=0) : leaf(leaf), i(i)
+        {
+            skip_exhausted();
+        }
+
+        reference operator*() const { return leaf->keys[i]; }
+        pointer operator->() const { return &leaf->keys[i]; }
+
+        iterator& operator++()
+        {
+            i++;
+            skip_exhausted();
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const iterator& other) const { return leaf == other.leaf && i == other.i; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+      private:
+        void skip_exhausted()
+        {
+            while (leaf && i >= leaf->keys.size()) {
+                leaf = leaf->next;
+                i = 0;
+            }
+        }
+    };
+
+    iterator begin() const
+    {
+        bplus_node *n = root;
+        while (!n->is_leaf())
+            n = n->children.front();
+        return iterator(n, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator();
+    }
+
+    // Return an iterator to the first key which is not less than the given one.
+    iterator lower_bound(int key) const
+    {
+        bplus_node *leaf = find_leaf(key);
+        return iterator(leaf, ab_rank(leaf->keys.data(), leaf->keys.size(), key));
+    }
+
+    // Call `callback` on all keys between `lo` and `hi` inclusive, in increasing order.
+    template<typename Callback>
+    void scan(int lo, int hi, Callback callback) const
+    {
+        for (iterator it = lower_bound(lo), last = end(); it != last && *it <= hi; ++it)
+            callback(*it);
+    }
+
+    // Append all keys between `lo` and `hi` inclusive to `out`, in increasing order.
+    void collect(int lo, int hi, std::vector<int>& out) const
+    {
+        scan(lo, hi, [&out](int key) { out.push_back(key); });
+    }
+};
+
+#endif
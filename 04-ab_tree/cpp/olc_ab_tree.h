@@ -0,0 +1,275 @@
+#ifndef DS1_OLC_AB_TREE_H
+#define DS1_OLC_AB_TREE_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "ab_tree.h"
+
+/*
+ *  Concurrent (a,b)-tree with optimistic lock coupling.
+ *
+ *  Every node has a version lock: a counter, which is odd while a writer
+ *  holds the node and which changes with every modification. Readers never
+ *  write to shared memory: they remember the version of a node, read it
+ *  and then check that the version did not change (otherwise they restart
+ *  from the root). Coupling means that the version of the parent is checked
+ *  again after the version of the child was read, so a reader cannot follow
+ *  a pointer into a node which has been split in the meantime.
+ *
+ *  Writers upgrade the optimistic lock of a node to an exclusive one by
+ *  a compare-and-swap of the version, so they lock only the nodes they
+ *  modify. To avoid locking whole paths, inserts split full nodes eagerly
+ *  on the way down; this needs b >= 2a, so that both halves of a full node
+ *  have at least a children. Nodes are never deleted while the tree exists,
+ *  which is why there is no remove.
+ *
+ *  Keys and children live inline in the node (up to B children), because
+ *  optimistic readers may see a node in the middle of a change, which must
+ *  not make them follow a dangling pointer to a reallocated vector.
+ */
+
+/*** One node ***/
+
+template<int B>
+class olc_ab_node {
+    std::atomic<uint64_t> version{0};
+
+  public:
+    int num_keys = 0;
+    int keys[B];
+    olc_ab_node *children[B+1];     // Null in leaves
+
+    olc_ab_node()
+    {
+        std::fill(children, children + B + 1, nullptr);
+    }
+
+    bool is_leaf() const { return children[0] == nullptr; }
+
+    // Wait until the node is not locked and return its version.
+    uint64_t read_lock() const
+    {
+        uint64_t v;
+        while ((v = version.load(std::memory_order_acquire)) & 1)
+            std::this_thread::yield();
+        return v;
+    }
+
+    // Check that the node has not changed since read_lock() returned v.
+    bool validate(uint64_t v) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) == v;
+    }
+
+    // Lock the node exclusively, provided it has not changed since version v.
+    bool upgrade(uint64_t v)
+    {
+        return version.compare_exchange_strong(v, v + 1, std::memory_order_acquire);
+    }
+
+    void write_unlock()
+    {
+        version.fetch_add(1, std::memory_order_release);
+    }
+
+    // Like find_branch of ab_node. The number of keys is clamped, because
+    // an optimistic reader can see any value.
+    bool find_branch(int key, std::size_t &i) const
+    {
+        std::size_t n = std::min<std::size_t>(num_keys, B - 1);
+        i = ab_rank(keys, n, key);
+        return i < n && keys[i] == key;
+    }
+
+    // Insert a new key at position i and a new child between keys i and i+1.
+    void insert_branch(std::size_t i, int key, olc_ab_node *child)
+    {
+        std::move_backward(keys + i, keys + num_keys, keys + num_keys + 1);
+        std::move_backward(children + i + 1, children + num_keys + 1, children + num_keys + 2);
+        keys[i] = key;
+        children[i + 1] = child;
+        num_keys++;
+    }
+};
+
+/*** Tree ***/
+
+template<int B>
+class olc_ab_tree {
+  public:
+    typedef olc_ab_node<B> Node;
+
+    int a;                          // Minimum allowed number of children
+    int b;                          // Maximum allowed number of children
+    std::atomic<Node *> root;       // Root node (even a tree with no keys has a root)
+    std::atomic<int> num_nodes;     // We keep track of how many nodes the tree has
+
+    // Create a new node and return a pointer to it.
+    Node *new_node()
+    {
+        num_nodes++;
+        return new Node;
+    }
+
+    // Constructor: initialize an empty tree with just the root.
+    olc_ab_tree(int a, int b)
+    {
+        EXPECT(a >= 2 && b >= 2*a, "Invalid values of a,b");
+        EXPECT(b <= B, "Value of b too large for the node type");
+        this->a = a;
+        this->b = b;
+        num_nodes = 0;
+        root = new_node();
+    }
+
+    // An auxiliary function for deleting a subtree recursively.
+    void delete_tree(Node *n)
+    {
+        if (!n->is_leaf())
+            for (int i=0; i <= n->num_keys; i++)
+                delete_tree(n->children[i]);
+        num_nodes--;
+        delete n;
+    }
+
+    // Destructor: delete all nodes. No other thread may use the tree any more.
+    ~olc_ab_tree()
+    {
+        delete_tree(root);
+        EXPECT(num_nodes == 0, "Memory leak detected: some nodes were not deleted");
+    }
+
+    // Find a key: returns true if it is present in the tree.
+    // Never blocks other threads.
+    bool find(int key) const
+    {
+    restart:
+        Node *n = root.load(std::memory_order_acquire);
+        uint64_t v = n->read_lock();
+        if (n != root.load(std::memory_order_acquire))
+            goto restart;
+
+        while (true) {
+            std::size_t i;
+            bool found = n->find_branch(key, i);
+            Node *child = n->children[i];
+            if (!n->validate(v))
+                goto restart;
+            if (found)
+                return true;
+            if (!child)
+                return false;
+
+            uint64_t child_v = child->read_lock();
+            if (!n->validate(v))
+                goto restart;
+            n = child;
+            v = child_v;
+        }
+    }
+
+    // Check that the data structure satisfies all invariants.
+    // No other thread may modify the tree at the same time.
+    void audit();
+
+    // Insert: add key to the tree (unless it was already present).
+    void insert(int key)
+    {
+    restart:
+        Node *parent = nullptr;
+        uint64_t parent_v = 0;
+        Node *n = root.load(std::memory_order_acquire);
+        uint64_t v = n->read_lock();
+        if (n != root.load(std::memory_order_acquire))
+            goto restart;
+
+        while (true) {
+            if (n->num_keys == b - 1) {
+                // n is full, so we split it now, while its parent is surely not full
+
+                if (parent && !parent->upgrade(parent_v))
+                    goto restart;
+                if (!n->upgrade(v)) {
+                    if (parent)
+                        parent->write_unlock();
+                    goto restart;
+                }
+                if (!parent && n != root.load(std::memory_order_acquire)) {
+                    // somebody else added a new root above n
+                    n->write_unlock();
+                    goto restart;
+                }
+
+                split(parent, n);
+
+                n->write_unlock();
+                if (parent)
+                    parent->write_unlock();
+                goto restart;
+            }
+
+            std::size_t i;
+            bool found = n->find_branch(key, i);
+            Node *child = n->children[i];
+            if (!n->validate(v))
+                goto restart;
+            if (found)
+                return;
+
+            if (!child) {
+                // n is a leaf, which is not full
+
+                if (!n->upgrade(v))
+                    goto restart;
+                n->insert_branch(i, key, nullptr);
+                n->write_unlock();
+                return;
+            }
+
+            if (parent && !parent->validate(parent_v))
+                goto restart;
+
+            parent = n;
+            parent_v = v;
+            n = child;
+            v = n->read_lock();
+            if (!parent->validate(parent_v))
+                goto restart;
+        }
+    }
+
+  private:
+    // Split a full node n (with b-1 keys) into n and a new right sibling.
+    // Both n and its parent (nullptr if n is the root) must be locked.
+    void split(Node *parent, Node *n)
+    {
+        Node * const m = new_node();
+        const int k = (b - 1) / 2;      // Keys staying in n
+        const int key = n->keys[k];
+
+        m->num_keys = n->num_keys - k - 1;
+        std::copy(n->keys + k + 1, n->keys + n->num_keys, m->keys);
+        std::copy(n->children + k + 1, n->children + n->num_keys + 1, m->children);
+        n->num_keys = k;
+
+        if (parent) {
+            std::size_t i;
+            parent->find_branch(key, i);
+            parent->insert_branch(i, key, m);
+        } else {
+            // we need a new layer
+
+            Node * const r = new_node();
+            r->num_keys = 1;
+            r->keys[0] = key;
+            r->children[0] = n;
+            r->children[1] = m;
+            root.store(r, std::memory_order_release);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef DS1_PAGED_AB_TREE_H
+#define DS1_PAGED_AB_TREE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ab_tree.h"
+
+/*
+ *  Persistent (a,b)-tree stored in a memory-mapped file.
+ *
+ *  The file consists of 4 KiB pages. Page 0 is a header, every other page
+ *  holds one node, and nodes refer to their children by page numbers,
+ *  so the file can be mapped anywhere. Opening an existing file makes
+ *  the tree available immediately; pages are read lazily by the kernel
+ *  when they are first touched, so the tree can be larger than memory.
+ *
+ *  The file grows by doubling and it is remapped when it does, so pointers
+ *  to nodes are valid only until the next page is allocated.
+ *  There is no remove yet.
+ */
+
+class paged_ab_tree {
+  public:
+    typedef uint32_t page_id;   // Page 0 is the header, so 0 means no node
+
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    // The largest b whose overflowing nodes (b keys, b+1 children) fit in a page
+    static constexpr int MAX_B = (PAGE_SIZE - sizeof(uint32_t)) / (sizeof(int32_t) + sizeof(page_id)) - 1;
+
+    struct node {
+        uint32_t num_keys;
+        int32_t keys[MAX_B];
+        page_id children[MAX_B + 1];    // 0 in leaves
+
+        // Insert a new key at position i and a new child between keys i and i+1.
+        void insert_branch(std::size_t i, int key, page_id child)
+        {
+            std::copy_backward(keys + i, keys + num_keys, keys + num_keys + 1);
+            std::copy_backward(children + i + 1, children + num_keys + 1, children + num_keys + 2);
+            keys[i] = key;
+            children[i + 1] = child;
+            num_keys++;
+        }
+    };
+    static_assert(sizeof(node) <= PAGE_SIZE, "Node does not fit in a page");
+
+    struct header {
+        char magic[8];
+        uint32_t page_size;
+        uint32_t a, b;
+        page_id root;
+        uint32_t num_pages;     // Pages in use, including the header
+    };
+
+  private:
+    static constexpr char MAGIC[8] = { 'A', 'B', 'T', 'R', 'E', 'E', '0', '1' };
+
+    int fd;
+    char *base;                 // Start of the mapping
+    std::size_t mapped_pages;   // Size of the file and the mapping in pages
+
+    void map(std::size_t pages)
+    {
+        EXPECT(ftruncate(fd, pages * PAGE_SIZE) == 0, "Cannot resize the tree file");
+        void *p = mmap(nullptr, pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        EXPECT(p != MAP_FAILED, "Cannot map the tree file");
+        base = (char *) p;
+        mapped_pages = pages;
+    }
+
+    // Allocate a new empty node. This can move all nodes in memory.
+    page_id new_page()
+    {
+        if (hdr()->num_pages == mapped_pages) {
+            munmap(base, mapped_pages * PAGE_SIZE);
+            map(2 * mapped_pages);
+        }
+        page_id id = hdr()->num_pages++;
+        memset(page(id), 0, PAGE_SIZE);
+        return id;
+    }
+
+  public:
+    int a;          // Minimum allowed number of children
+    int b;          // Maximum allowed number of children
+
+    header *hdr() const { return (header *) base; }
+    node *page(page_id id) const { return (node *) (base + id * PAGE_SIZE); }
+    page_id root() const { return hdr()->root; }
+    std::size_t num_pages() const { return hdr()->num_pages; }
+
+    // Open the tree in the given file, or create an empty one if the file
+    // does not exist or is empty. An existing tree must have the same a and b.
+    paged_ab_tree(const std::string &path, int a, int b)
+    {
+        EXPECT(a >= 2 && b >= 2*a - 1, "Invalid values of a,b");
+        EXPECT(b <= MAX_B, "Value of b too large for a page");
+        this->a = a;
+        this->b = b;
+
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+        EXPECT(fd >= 0, "Cannot open the tree file");
+        struct stat st;
+        EXPECT(fstat(fd, &st) == 0, "Cannot stat the tree file");
+
+        if (st.st_size == 0) {
+            map(16);
+            header *h = hdr();
+            memcpy(h->magic, MAGIC, sizeof(MAGIC));
+            h->page_size = PAGE_SIZE;
+            h->a = a;
+            h->b = b;
+            h->num_pages = 1;
+            // The root has no keys and one null child.
+            h->root = new_page();
+        } else {
+            EXPECT(st.st_size % PAGE_SIZE == 0, "Tree file has a wrong size");
+            map(st.st_size / PAGE_SIZE);
+            header *h = hdr();
+            EXPECT(!memcmp(h->magic, MAGIC, sizeof(MAGIC)) && h->page_size == PAGE_SIZE, "Not a tree file");
+            EXPECT(h->a == a && h->b == b, "Tree file has different values of a,b");
+            EXPECT(h->num_pages <= mapped_pages, "Tree file is truncated");
+        }
+    }
+
+    paged_ab_tree(const paged_ab_tree&) = delete;
+    paged_ab_tree& operator=(const paged_ab_tree&) = delete;
+
+    // Destructor: unmap the file. The kernel writes the changes back eventually.
+    ~paged_ab_tree()
+    {
+        munmap(base, mapped_pages * PAGE_SIZE);
+        close(fd);
+    }
+
+    // Write all changes to the disk now.
+    void sync()
+    {
+        EXPECT(msync(base, mapped_pages * PAGE_SIZE, MS_SYNC) == 0, "Cannot write the tree file");
+    }
+
+    // Find a key: returns true if it is present in the tree.
+    bool find(int key) const
+    {
+        page_id id = root();
+        while (id) {
+            const node *n = page(id);
+            std::size_t i = ab_rank(n->keys, n->num_keys, key);
+            if (i < n->num_keys && n->keys[i] == key)
+                return true;
+            id = n->children[i];
+        }
+        return false;
+    }
+
+    // Check that the data structure satisfies all invariants.
+    void audit();
+
+    // Insert: add key to the tree (unless it was already present).
+    void insert(int key)
+    {
+        page_id id = root();
+        std::size_t i;
+
+        // holds the path to the inserted key
+        ab_path<page_id> parents;
+
+        while (true) {
+            const node *n = page(id);
+            i = ab_rank(n->keys, n->num_keys, key);
+            if (i < n->num_keys && n->keys[i] == key)
+                return;
+
+            parents.emplace(id, i);
+            if (!n->children[i])
+                break;
+            id = n->children[i];
+        }
+
+        page(id)->insert_branch(i, key, 0);
+
+        while (page(id)->num_keys >= b) {
+            // splitting n into n and m
+
+            const page_id m_id = new_page();
+            node * const n = page(id);
+            node * const m = page(m_id);
+
+            i = n->num_keys / 2 + 1;
+            key = n->keys[i - 1];
+
+            m->num_keys = n->num_keys - i;
+            std::copy(n->keys + i, n->keys + n->num_keys, m->keys);
+            std::copy(n->children + i, n->children + n->num_keys + 1, m->children);
+            n->num_keys = i - 1;
+
+            if (id == root()) {
+                // we need a new layer
+
+                const page_id r_id = new_page();
+                node * const r = page(r_id);
+                r->num_keys = 1;
+                r->keys[0] = key;
+                r->children[0] = id;
+                r->children[1] = m_id;
+                hdr()->root = r_id;
+
+                return;
+            } else {
+                // we add m as n's right sibling and propagate upwards
+
+                parents.pop();
+                const auto [parent, j] = parents.top();
+
+                page(parent)->insert_branch(j, key, m_id);
+                id = parent;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1 @@
+../../03-splay_experiment/cpp/throughput.h
\ No newline at end of file